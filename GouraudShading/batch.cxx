@@ -0,0 +1,176 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "clip.h"
+#include "fill.h"
+
+namespace {
+
+// what the back end needs of a triangle, copied into every bin it lands
+// in, so a tile reads its triangles front to back instead of gathering
+// them from all over the batch
+struct BinnedTriangle
+{
+    TriangleSetup setup;
+    Color colors[3];
+    float z[3];
+};
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+TriangleView TriangleView::slice(int begin, int end) const
+{
+    if (indices)
+        return TriangleView(vertices, colors, depths, indices + 3 * (size_t) begin, end - begin);
+    size_t v = 3 * (size_t) begin;
+    return TriangleView(vertices + v, colors + v, depths ? depths + v : nullptr, nullptr, end - begin);
+}
+
+void BatchStats::add(const BatchStats& s)
+{
+    drawn += s.drawn;
+    bin_entries += s.bin_entries;
+    area += s.area;
+    setup_ms += s.setup_ms;
+    raster_ms += s.raster_ms;
+    depth.add(s.depth);
+}
+
+BatchStats rasterize_batch(const TriangleView& batch, Framebuffer& fb, WorkerPool& pool, int tile,
+                           DepthBuffer* depth)
+{
+    BatchStats stats;
+    if (depth) tile = (tile + DepthBuffer::TILE - 1) / DepthBuffer::TILE * DepthBuffer::TILE;
+    int ntris = batch.count;
+    int tx = (fb.width + tile - 1) / tile, ty = (fb.height + tile - 1) / tile;
+    int ntiles = tx * ty;
+    // a few chunks per thread, so a chunk of big triangles does not hold
+    // the front end up
+    int nchunks = std::max(1, std::min(ntris, 4 * pool.threads()));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<std::vector<BinnedTriangle>>> bins(
+        nchunks, std::vector<std::vector<BinnedTriangle>>(ntiles));
+    std::vector<int> drawn(nchunks, 0);
+    std::vector<double> area(nchunks, 0);
+    std::vector<long long> entries(nchunks, 0);
+
+    pool.run(nchunks, [&](int c, int) {
+        int begin = (int) ((long long) ntris * c / nchunks);
+        int end = (int) ((long long) ntris * (c + 1) / nchunks);
+        ClippedTriangle clipped[MAX_CLIPPED];
+        for (int t = begin; t < end; t++) {
+            Point p[3];
+            Color colors[3];
+            float z[3] = { 0, 0, 0 };
+            for (int k = 0; k < 3; k++) {
+                unsigned v = batch.vertex(t, k);
+                p[k] = batch.vertices[v];
+                colors[k] = batch.colors[v];
+                if (depth) z[k] = batch.depths[v];
+            }
+            int n = clip_triangle(p, fb.width, fb.height, clipped);
+            if (n == 0) continue;
+            drawn[c]++;
+            for (int piece = 0; piece < n; piece++) {
+                BinnedTriangle b;
+                b.setup = clipped[piece].setup;
+                for (int k = 0; k < 3; k++) {
+                    b.colors[k] = clipped_color(clipped[piece], k, colors);
+                    b.z[k] = clipped_value(clipped[piece], k, z);
+                }
+                const TriangleSetup& s = b.setup;
+                for (int j = s.ymin / tile; j <= s.ymax / tile; j++)
+                    for (int i = s.xmin / tile; i <= s.xmax / tile; i++)
+                        bins[c][j * tx + i].push_back(b);
+                area[c] += 0.5 * s.area;
+                entries[c] += (s.ymax / tile - s.ymin / tile + 1) * (s.xmax / tile - s.xmin / tile + 1);
+            }
+        }
+    });
+    stats.setup_ms = ms_since(start);
+    for (int c = 0; c < nchunks; c++) {
+        stats.drawn += drawn[c];
+        stats.area += area[c];
+        stats.bin_entries += entries[c];
+    }
+
+    start = std::chrono::steady_clock::now();
+    std::vector<DepthStats> depth_stats(depth ? ntiles : 0);
+    pool.run(ntiles, [&](int k, int) {
+        int x0 = (k % tx) * tile, y0 = (k / tx) * tile;
+        int x1 = std::min(x0 + tile, fb.width) - 1, y1 = std::min(y0 + tile, fb.height) - 1;
+        for (int c = 0; c < nchunks; c++) {
+            for (const BinnedTriangle& b : bins[c][k]) {
+                TriangleSetup r;
+                if (!restrict_setup(b.setup, x0, y0, x1, y1, r)) continue;
+                if (depth)
+                    fill_gouraud_depth(r, b.colors, b.z, fb, *depth, depth_stats[k]);
+                else
+                    fill_gouraud(r, b.colors, fb);
+            }
+        }
+    });
+    stats.raster_ms = ms_since(start);
+    for (size_t k = 0; k < depth_stats.size(); k++)
+        stats.depth.add(depth_stats[k]);
+    return stats;
+}
+
+void random_batch(int n, int size, int width, int height, unsigned seed, TriangleBatch& batch)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> offset(0, std::max(size - 1, 0));
+    std::uniform_int_distribution<int> cx(0, std::max(width - size, 0)), cy(0, std::max(height - size, 0));
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    batch.vertices.resize(3 * (size_t) n);
+    batch.colors.resize(3 * (size_t) n);
+    batch.indices.resize(3 * (size_t) n);
+    for (int t = 0; t < n; t++) {
+        int x = cx(rng), y = cy(rng);
+        for (int k = 0; k < 3; k++) {
+            size_t v = 3 * (size_t) t + k;
+            batch.vertices[v] = Point(x + offset(rng), y + offset(rng));
+            batch.colors[v] = Color(unit(rng), unit(rng), unit(rng));
+            batch.indices[v] = (unsigned) v;
+        }
+    }
+
+    // depths come from a generator of their own, so the triangles and
+    // colors are the same as before depths were added
+    std::mt19937 zrng(seed + 0x9e3779b9u);
+    std::uniform_real_distribution<float> tilt(-0.01f, 0.01f);
+    batch.depths.resize(3 * (size_t) n);
+    for (int t = 0; t < n; t++) {
+        float z = unit(zrng);
+        for (int k = 0; k < 3; k++)
+            batch.depths[3 * (size_t) t + k] = std::min(std::max(z + tilt(zrng), 0.0f), 1.0f);
+    }
+}
+
+void sort_by_depth(TriangleBatch& batch, bool front_to_back)
+{
+    int n = batch.triangles();
+    std::vector<std::pair<float, int>> order(n);
+    for (int t = 0; t < n; t++) {
+        float z = 0;
+        for (int k = 0; k < 3; k++)
+            z += batch.depths[batch.indices[3 * t + k]];
+        order[t] = std::make_pair(front_to_back ? z : -z, t);
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<unsigned> indices(batch.indices.size());
+    for (int t = 0; t < n; t++)
+        for (int k = 0; k < 3; k++)
+            indices[3 * t + k] = batch.indices[3 * order[t].second + k];
+    batch.indices.swap(indices);
+}
@@ -0,0 +1,87 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include "raster.h"
+#include "framebuffer.h"
+#include "depth.h"
+#include "parallel.h"
+
+// A stream of Gouraud-shaded triangles: vertices with one color and one
+// depth each, and three vertex indices per triangle, drawn in the order
+// of indices.
+struct TriangleBatch
+{
+    std::vector<Point> vertices;
+    std::vector<Color> colors;        // one per vertex
+    std::vector<float> depths;        // one per vertex, for a depth buffer
+    std::vector<unsigned> indices;    // three per triangle
+
+    int triangles() const { return (int) (indices.size() / 3); }
+};
+
+// Triangles in arrays owned by someone else, e.g. a TriangleBatch or a
+// mapped triangle stream (stream.h). Triangle t has the vertices
+// indices[3t], indices[3t + 1] and indices[3t + 2], or 3t, 3t + 1 and
+// 3t + 2 if indices is null. depths may be null if no depth buffer is used.
+struct TriangleView
+{
+    const Point* vertices;
+    const Color* colors;
+    const float* depths;
+    const unsigned* indices;
+    int count;                     // triangles
+
+    TriangleView(const Point* vertices, const Color* colors, const float* depths,
+                 const unsigned* indices, int count)
+        : vertices(vertices), colors(colors), depths(depths), indices(indices), count(count) {}
+    TriangleView(const TriangleBatch& b)
+        : vertices(b.vertices.data()), colors(b.colors.data()), depths(b.depths.data()),
+          indices(b.indices.data()), count(b.triangles()) {}
+
+    unsigned vertex(int t, int k) const { return indices ? indices[3 * t + k] : 3 * (unsigned) t + k; }
+    // triangles [begin, end)
+    TriangleView slice(int begin, int end) const;
+};
+
+struct BatchStats
+{
+    int drawn = 0;                 // triangles that touch the framebuffer
+    long long bin_entries = 0;     // (triangle, tile) pairs
+    double area = 0;               // of the drawn triangles, about the pixels drawn
+    double setup_ms = 0;           // front end: setup and binning
+    double raster_ms = 0;          // back end: tiles
+    DepthStats depth;              // with a depth buffer
+
+    void add(const BatchStats& s);
+};
+
+// Draws every triangle of batch into fb on the threads of pool, as if
+// drawn one after the other with rasterize_gouraud().
+//
+// The front end splits the triangles into contiguous chunks, one job per
+// chunk. Each job sets its triangles up and appends them to per-chunk
+// lists (bins) of the screen tiles (tile x tile pixels) their bounding
+// boxes overlap. The back end then runs one job per tile. It draws the
+// tile's triangles chunk by chunk, each restricted to the tile. Every tile
+// is owned by one thread and every bin is written by one thread, so
+// neither pass takes a lock. Within a tile, triangles are drawn in
+// submission order, so the image does not depend on the thread count or
+// tile.
+//
+// With a depth buffer (of the size of fb), triangles are depth tested
+// with fill_gouraud_depth(); tile is then rounded up to a multiple of
+// DepthBuffer::TILE, so every depth tile belongs to one screen tile.
+BatchStats rasterize_batch(const TriangleView& batch, Framebuffer& fb, WorkerPool& pool, int tile = 64,
+                           DepthBuffer* depth = nullptr);
+
+// n random triangles of at most size pixels across, inside a width x
+// height viewport, with random vertex colors and a random depth each
+// (tilted a little across the triangle); the same for the same seed
+void random_batch(int n, int size, int width, int height, unsigned seed, TriangleBatch& batch);
+
+// reorders the triangles by the mean depth of their vertices, nearest
+// first if front_to_back, else farthest first
+void sort_by_depth(TriangleBatch& batch, bool front_to_back);
+
+#endif
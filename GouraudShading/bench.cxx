@@ -0,0 +1,653 @@
+// Throughput and coverage benchmark of the rasterizer
+//
+// For every triangle set of scenes.h it times, separately:
+//   flat     every triangle set up and filled with one color, in order,
+//            with each fill kernel the CPU supports
+//   gouraud  the same with the vertex colors interpolated
+//   batch    the Gouraud set through rasterize_batch() on each thread count
+//   varyings the same through rasterize_varyings(), once with the colors
+//            alone and once with color, UV, normal and depth, corrected
+//            for perspective
+// and reports triangles/sec and pixels/sec as JSON. The pixels are those
+// the triangles cover, overdraw included.
+//
+// It then checks coverage pixel by pixel against a slow reference that
+// tests every pixel of every triangle's box on its own, in 64-bit
+// arithmetic: every kernel and the batch rasterizer must draw exactly the
+// reference's pixels, with the same triangle on top, and all Gouraud
+// images must be byte-identical. Triangles that leave the guard band are
+// cut at rounded vertices (clip.h), so pixels within half a pixel of
+// their edges may differ; they are counted apart. In the mesh, no pixel
+// may be drawn twice and none inside may be left out. Exits with status
+// 1 if anything differs, so optimizations cannot change coverage
+// unnoticed.
+//
+// Last, it checks that rasterize_varyings() corrects attributes for
+// perspective: see check_perspective().
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "raster.h"
+#include "framebuffer.h"
+#include "clip.h"
+#include "fill.h"
+#include "interpolate.h"
+#include "batch.h"
+#include "scenes.h"
+#include "parallel.h"
+
+using namespace std;
+
+struct Settings
+{
+    int width = 1024, height = 768;
+    vector<string> scenes = scene_names();
+    vector<int> threads;               // default: 1 and all hardware threads
+    int repeat = 3;
+    int tile = 64;
+    unsigned seed = 1;
+    string label;
+    string out;                        // JSON file, stdout if empty
+};
+
+// What the reference draws: for every pixel the number of triangles that
+// cover it and the last of them (index + 1, 0 for none).
+struct Coverage
+{
+    vector<int> count, top;
+    long long pixels = 0;              // summed over all triangles
+    // pixels within half a pixel of an edge of a triangle that leaves the
+    // guard band; the rounded vertices it is cut at may move such an edge
+    // by up to that much (clip.h)
+    vector<char> near_cut;
+    bool cut = false;                  // any such triangle
+};
+
+// Coverage computed the slow way, independently of raster.cxx: every pixel
+// of a triangle's (clamped) box is tested against the three edge
+// functions, evaluated directly in 64-bit arithmetic, with the same fill
+// rule.
+void reference_coverage(const TriangleBatch& batch, int width, int height, Coverage& cov)
+{
+    cov.count.assign((size_t) width * height, 0);
+    cov.top.assign((size_t) width * height, 0);
+    cov.pixels = 0;
+    cov.near_cut.assign((size_t) width * height, 0);
+    cov.cut = false;
+    for (int t = 0; t < batch.triangles(); t++) {
+        Point p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = batch.vertices[batch.indices[3 * t + k]];
+        long long area = (long long) (p[1].x - p[0].x) * (p[2].y - p[0].y) -
+                         (long long) (p[1].y - p[0].y) * (p[2].x - p[0].x);
+        if (area == 0) continue;
+        long long sign = area > 0 ? 1 : -1;
+        bool cut = false;
+        for (int k = 0; k < 3; k++)
+            cut = cut || p[k].x < -GUARD_BAND || p[k].x >= GUARD_BAND || p[k].y < -GUARD_BAND || p[k].y >= GUARD_BAND;
+        cov.cut = cov.cut || cut;
+
+        int xmin = max(min(min(p[0].x, p[1].x), p[2].x), 0);
+        int ymin = max(min(min(p[0].y, p[1].y), p[2].y), 0);
+        int xmax = min(max(max(p[0].x, p[1].x), p[2].x), width - 1);
+        int ymax = min(max(max(p[0].y, p[1].y), p[2].y), height - 1);
+        for (int y = ymin; y <= ymax; y++) {
+            for (int x = xmin; x <= xmax; x++) {
+                bool inside = true;
+                size_t k = (size_t) y * width + x;
+                for (int j = 0; j < 3; j++) {
+                    const Point& a = p[(j + 1) % 3];
+                    const Point& b = p[(j + 2) % 3];
+                    long long dx = -sign * (b.y - a.y), dy = sign * (b.x - a.x);
+                    long long e = dy * (y - a.y) + dx * (x - a.x);
+                    bool owned = dx > 0 || (dx == 0 && dy > 0);
+                    inside = inside && (e > 0 || (e == 0 && owned));
+                    if (cut && fabs((double) e) <= 0.5 * hypot((double) dx, (double) dy))
+                        cov.near_cut[k] = 1;
+                }
+                if (!inside) continue;
+                cov.count[k]++;
+                cov.top[k] = t + 1;
+                cov.pixels++;
+            }
+        }
+    }
+}
+
+// a color that encodes triangle t exactly in the 24 bits of a pixel
+Color id_color(int t)
+{
+    unsigned id = (unsigned) t + 1;
+    return Color((id & 255) / 255.0f, (id >> 8 & 255) / 255.0f, (id >> 16 & 255) / 255.0f);
+}
+
+// pixels of fb whose triangle (id_color()) is not the reference's, apart
+// from those next to the edges of cut triangles, which are counted in
+// near_cut
+long long top_mismatches(const Framebuffer& fb, const Coverage& cov, long long& near_cut)
+{
+    long long bad = 0;
+    near_cut = 0;
+    for (size_t k = 0; k < fb.pixels.size(); k++) {
+        if ((int) (fb.pixels[k] & 0xffffff) == cov.top[k]) continue;
+        if (cov.near_cut[k]) near_cut++;
+        else bad++;
+    }
+    return bad;
+}
+
+long long pixel_differences(const Framebuffer& a, const Framebuffer& b)
+{
+    long long d = 0;
+    for (size_t k = 0; k < a.pixels.size(); k++)
+        if (a.pixels[k] != b.pixels[k]) d++;
+    return d;
+}
+
+enum Mode { FLAT, GOURAUD };
+
+// draws the triangles one after the other with the fill kernels in use;
+// FLAT uses the color of each triangle's first vertex
+void draw_sequential(const TriangleBatch& batch, Mode mode, Framebuffer& fb)
+{
+    for (int t = 0; t < batch.triangles(); t++) {
+        Point p[3];
+        Color c[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = batch.vertices[batch.indices[3 * t + k]];
+            c[k] = batch.colors[batch.indices[3 * t + k]];
+        }
+        ClippedTriangle clipped[MAX_CLIPPED];
+        int n = clip_triangle(p, fb.width, fb.height, clipped);
+        for (int i = 0; i < n; i++) {
+            const ClippedTriangle& s = clipped[i];
+            if (mode == FLAT) fill_flat(s.setup, c[0], fb);
+            else {
+                Color ci[3] = { clipped_color(s, 0, c), clipped_color(s, 1, c), clipped_color(s, 2, c) };
+                fill_gouraud(s.setup, ci, fb);
+            }
+        }
+    }
+}
+
+typedef Layout<ColorAttr> ColorOnly;
+typedef Layout<ColorAttr, UVAttr, NormalAttr, DepthAttr> Shaded;
+
+void store(const Color& c, float* v)
+{
+    v[0] = c.r;
+    v[1] = c.g;
+    v[2] = c.b;
+}
+
+// the attributes of vertex i of the batch
+void vertex_varyings(const TriangleBatch& batch, unsigned i, const Framebuffer&, Varyings<ColorOnly>& v)
+{
+    store(batch.colors[i], v.get<ColorAttr>());
+}
+
+void vertex_varyings(const TriangleBatch& batch, unsigned i, const Framebuffer& fb, Varyings<Shaded>& v)
+{
+    store(batch.colors[i], v.get<ColorAttr>());
+    float* uv = v.get<UVAttr>();
+    uv[0] = (float) batch.vertices[i].x / fb.width;
+    uv[1] = (float) batch.vertices[i].y / fb.height;
+    float d = batch.depths[i];
+    float* n = v.get<NormalAttr>();
+    n[0] = d - 0.5f;
+    n[1] = 0.5f - d;
+    n[2] = 1;
+    v.get<DepthAttr>()[0] = d;
+}
+
+Color shade(const Varyings<ColorOnly>& v)
+{
+    const float* c = v.get<ColorAttr>();
+    return Color(c[0], c[1], c[2]);
+}
+
+// uses every attribute, so none is optimized away
+Color shade(const Varyings<Shaded>& v)
+{
+    const float* c = v.get<ColorAttr>();
+    const float* uv = v.get<UVAttr>();
+    const float* n = v.get<NormalAttr>();
+    float s = n[2] * (1 - 0.5f * v.get<DepthAttr>()[0]) * (((int) (uv[0] * 64) + (int) (uv[1] * 64)) % 2 ? 1.0f : 0.5f);
+    return Color(c[0] * s + n[0], c[1] * s + n[1], c[2] * s);
+}
+
+// draws the triangles one after the other with rasterize_varyings(); the
+// vertices' w are 1 + their depth
+template <class L>
+void draw_varyings(const TriangleBatch& batch, Framebuffer& fb)
+{
+    for (int t = 0; t < batch.triangles(); t++) {
+        Point p[3];
+        Varyings<L> v[3];
+        float w[3];
+        for (int k = 0; k < 3; k++) {
+            unsigned i = batch.indices[3 * t + k];
+            p[k] = batch.vertices[i];
+            vertex_varyings(batch, i, fb, v[k]);
+            w[k] = 1 + batch.depths[i];
+        }
+        ClippedTriangle clipped[MAX_CLIPPED];
+        int n = clip_triangle(p, fb.width, fb.height, clipped);
+        for (int i = 0; i < n; i++) {
+            Varyings<L> vi[3];
+            float wi[3];
+            for (int k = 0; k < 3; k++)
+                clipped_varyings(clipped[i], k, v, w, vi[k], wi[k]);
+            rasterize_varyings(clipped[i].setup, vi, wi,
+                               [&fb](int x, int y, const Varyings<L>& a) { fb.set(x, y, shade(a)); });
+        }
+    }
+}
+
+// Perspective check: one triangle with a different w at every vertex,
+// its color and UV interpolated by rasterize_varyings() and compared at
+// every pixel with the exact value (sum l_k a_k / w_k) / (sum l_k / w_k),
+// where l_k are the pixel's screen weights, computed here in double. The
+// same triangle with its UV declared affine must come out as sum l_k a_k
+// and miss the exact value by far, so the check can tell a corrected
+// attribute from an uncorrected one.
+struct AffineUVAttr : Attribute<2, false> {};
+typedef Layout<ColorAttr, UVAttr> PerspectiveUV;
+typedef Layout<ColorAttr, AffineUVAttr> AffineUV;
+
+struct PerspectiveCheck
+{
+    long long pixels = 0;
+    double error = 0;          // largest error of the corrected color and UV
+    double affine_error = 0;   // largest error of the affine UV against the exact value
+    double affine_drift = 0;   // largest difference of the affine UV from sum l_k a_k
+
+    bool ok() const { return pixels > 0 && error < 1e-4 && affine_drift < 1e-4 && affine_error > 0.05; }
+};
+
+template <class UV>
+void set_vertex(Varyings<Layout<ColorAttr, UV>>& v, const Color& c, float u, float t)
+{
+    store(c, v.template get<ColorAttr>());
+    v.template get<UV>()[0] = u;
+    v.template get<UV>()[1] = t;
+}
+
+PerspectiveCheck check_perspective()
+{
+    const int SIZE = 256;
+    const Point p[3] = { Point(8, 8), Point(248, 40), Point(40, 248) };
+    const float w[3] = { 1, 4, 10 };
+    const Color c[3] = { Color(1, 0, 0), Color(0, 1, 0), Color(0, 0, 1) };
+    const float uv[3][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+
+    PerspectiveCheck check;
+    TriangleSetup t;
+    if (!setup_triangle(p, SIZE, SIZE, t)) return check;
+    Varyings<PerspectiveUV> v[3];
+    Varyings<AffineUV> a[3];
+    for (int k = 0; k < 3; k++) {
+        set_vertex(v[k], c[k], uv[k][0], uv[k][1]);
+        set_vertex(a[k], c[k], uv[k][0], uv[k][1]);
+    }
+
+    // the screen weights of pixel (x, y), the edge functions over their sum
+    auto weights = [&](int x, int y, double l[3]) {
+        double sum = 0;
+        for (int k = 0; k < 3; k++) {
+            const Point& e0 = p[(k + 1) % 3];
+            const Point& e1 = p[(k + 2) % 3];
+            l[k] = (double) (e1.x - e0.x) * (y - e0.y) - (double) (e1.y - e0.y) * (x - e0.x);
+            sum += l[k];
+        }
+        for (int k = 0; k < 3; k++)
+            l[k] /= sum;
+    };
+    // attribute i of the vertices interpolated with weights l
+    auto mix = [&](const double l[3], int i) {
+        double r = 0;
+        for (int k = 0; k < 3; k++)
+            r += l[k] * (i < 3 ? (&c[k].r)[i] : uv[k][i - 3]);
+        return r;
+    };
+    auto corrected = [&](const double l[3], double q[3]) {
+        double sum = 0;
+        for (int k = 0; k < 3; k++)
+            sum += q[k] = l[k] / w[k];
+        for (int k = 0; k < 3; k++)
+            q[k] /= sum;
+    };
+
+    rasterize_varyings(t, v, w, [&](int x, int y, const Varyings<PerspectiveUV>& o) {
+        double l[3], q[3];
+        weights(x, y, l);
+        corrected(l, q);
+        const float* color = o.get<ColorAttr>();
+        const float* uv = o.get<UVAttr>();
+        for (int i = 0; i < 5; i++)
+            check.error = max(check.error, fabs((i < 3 ? color[i] : uv[i - 3]) - mix(q, i)));
+        check.pixels++;
+    });
+    rasterize_varyings(t, a, w, [&](int x, int y, const Varyings<AffineUV>& o) {
+        double l[3], q[3];
+        weights(x, y, l);
+        corrected(l, q);
+        const float* uv = o.get<AffineUVAttr>();
+        for (int i = 3; i < 5; i++) {
+            check.affine_error = max(check.affine_error, fabs(uv[i - 3] - mix(q, i)));
+            check.affine_drift = max(check.affine_drift, fabs(uv[i - 3] - mix(l, i)));
+        }
+    });
+    return check;
+}
+
+// fastest of repeat runs of draw, in ms
+template <class Draw>
+double best_ms(int repeat, Framebuffer& fb, Draw draw)
+{
+    double best = numeric_limits<double>::infinity();
+    for (int r = 0; r < repeat; r++) {
+        fb.clear(Color(0.0, 0.0, 0.0));
+        auto start = chrono::steady_clock::now();
+        draw();
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+string json_string(const string& s)
+{
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        r += c;
+    }
+    return r + "\"";
+}
+
+string json_run(const char* mode, const string& kernel, int threads, double ms, int triangles, long long pixels)
+{
+    ostringstream o;
+    o << "        {\"mode\": " << json_string(mode) << ", \"kernel\": " << json_string(kernel)
+      << ", \"threads\": " << threads << ", \"ms\": " << ms
+      << ", \"mtriangles_per_s\": " << triangles / (ms * 1e3)
+      << ", \"mpixels_per_s\": " << pixels / (ms * 1e3) << "}";
+    return o.str();
+}
+
+// the fill kernels this CPU can run, widest last
+vector<string> kernels()
+{
+    vector<string> k;
+    for (const char* name : { "scalar", "avx2" })
+        if (!select_fill(name).empty()) k.push_back(name);
+    return k;
+}
+
+// benchmarks and checks one scene; false if the coverage check failed
+bool run_scene(const Settings& set, const string& name, ostream& out)
+{
+    TriangleBatch batch;
+    make_scene(name, set.width, set.height, set.seed, batch);
+    int ntris = batch.triangles();
+    Coverage cov;
+    reference_coverage(batch, set.width, set.height, cov);
+
+    Framebuffer fb(set.width, set.height);
+    vector<string> runs;
+    vector<string> ks = kernels();
+    for (const string& k : ks) {
+        select_fill(k);
+        for (Mode mode : { FLAT, GOURAUD }) {
+            double ms = best_ms(set.repeat, fb, [&]() { draw_sequential(batch, mode, fb); });
+            runs.push_back(json_run(mode == FLAT ? "flat" : "gouraud", k, 1, ms, ntris, cov.pixels));
+        }
+    }
+    double ms = best_ms(set.repeat, fb, [&]() { draw_varyings<ColorOnly>(batch, fb); });
+    runs.push_back(json_run("varyings_color", "scalar", 1, ms, ntris, cov.pixels));
+    ms = best_ms(set.repeat, fb, [&]() { draw_varyings<Shaded>(batch, fb); });
+    runs.push_back(json_run("varyings_shaded", "scalar", 1, ms, ntris, cov.pixels));
+    string widest = ks.back();
+    select_fill(widest);
+    for (int n : set.threads) {
+        WorkerPool pool(n);
+        double ms = best_ms(set.repeat, fb, [&]() { rasterize_batch(batch, fb, pool, set.tile); });
+        runs.push_back(json_run("batch", widest, n, ms, ntris, cov.pixels));
+    }
+
+    // coverage: the triangle on top of every pixel, drawn in id colors
+    TriangleBatch ids = batch;
+    for (int t = 0; t < ntris; t++)
+        for (int k = 0; k < 3; k++)
+            ids.colors[ids.indices[3 * t + k]] = id_color(t);
+    // vertices shared by several triangles need copies of their own
+    if (name == "mesh") {
+        ids.vertices.clear();
+        ids.colors.clear();
+        ids.depths.clear();
+        for (int t = 0; t < ntris; t++) {
+            for (int k = 0; k < 3; k++) {
+                ids.vertices.push_back(batch.vertices[batch.indices[3 * t + k]]);
+                ids.colors.push_back(id_color(t));
+                ids.depths.push_back(batch.depths[batch.indices[3 * t + k]]);
+                ids.indices[3 * t + k] = 3 * t + k;
+            }
+        }
+    }
+
+    bool ok = true;
+    vector<pair<string, long long>> mismatches, near_cut, differences;
+    Framebuffer reference(set.width, set.height), image(set.width, set.height);
+    auto check_top = [&](const string& label) {
+        long long near;
+        mismatches.push_back(make_pair(label, top_mismatches(image, cov, near)));
+        near_cut.push_back(make_pair(label, near));
+    };
+    select_fill("scalar");
+    reference.clear(Color(0.0, 0.0, 0.0));
+    draw_sequential(batch, GOURAUD, reference);
+    for (const string& k : ks) {
+        select_fill(k);
+        image.clear(Color(0.0, 0.0, 0.0));
+        draw_sequential(ids, FLAT, image);
+        check_top(k);
+        image.clear(Color(0.0, 0.0, 0.0));
+        draw_sequential(batch, GOURAUD, image);
+        differences.push_back(make_pair(k, pixel_differences(image, reference)));
+    }
+    // with a single color per triangle, corrected weights that sum to 1
+    // within rounding still give the exact id
+    image.clear(Color(0.0, 0.0, 0.0));
+    draw_varyings<ColorOnly>(ids, image);
+    check_top("varyings");
+    for (int n : set.threads) {
+        ostringstream label;
+        label << "batch_" << n;
+        WorkerPool pool(n);
+        image.clear(Color(0.0, 0.0, 0.0));
+        rasterize_batch(ids, image, pool, set.tile);
+        check_top(label.str());
+        image.clear(Color(0.0, 0.0, 0.0));
+        rasterize_batch(batch, image, pool, set.tile);
+        differences.push_back(make_pair(label.str(), pixel_differences(image, reference)));
+    }
+    select_fill(widest);
+
+    // the mesh covers the box of its vertices; its right and bottom edges
+    // belong to whatever would be next to them
+    long long overlaps = 0, holes = 0;
+    if (name == "mesh") {
+        int x0 = set.width, y0 = set.height, x1 = 0, y1 = 0;
+        for (const Point& p : batch.vertices) {
+            x0 = min(x0, p.x);
+            y0 = min(y0, p.y);
+            x1 = max(x1, p.x);
+            y1 = max(y1, p.y);
+        }
+        for (int y = 0; y < set.height; y++) {
+            for (int x = 0; x < set.width; x++) {
+                int c = cov.count[(size_t) y * set.width + x];
+                if (c > 1) overlaps++;
+                if (c == 0 && x >= x0 && x < x1 && y >= y0 && y < y1) holes++;
+            }
+        }
+    }
+
+    for (auto& m : mismatches)
+        if (m.second) ok = false;
+    for (auto& d : differences)
+        if (d.second) ok = false;
+    if (overlaps || holes) ok = false;
+    if (!ok)
+        cerr << "bench: coverage of " << name << " differs from the reference" << endl;
+
+    out << "    {\"scene\": " << json_string(name) << ", \"triangles\": " << ntris
+        << ", \"pixels\": " << cov.pixels << ",\n"
+        << "      \"runs\": [\n";
+    for (size_t k = 0; k < runs.size(); k++)
+        out << runs[k] << (k + 1 < runs.size() ? ",\n" : "\n");
+    out << "      ],\n"
+        << "      \"coverage\": {\"ok\": " << (ok ? "true" : "false") << ", \"top_mismatches\": {";
+    for (size_t k = 0; k < mismatches.size(); k++)
+        out << (k ? ", " : "") << json_string(mismatches[k].first) << ": " << mismatches[k].second;
+    out << "}, ";
+    if (cov.cut) {
+        out << "\"near_cut_edges\": {";
+        for (size_t k = 0; k < near_cut.size(); k++)
+            out << (k ? ", " : "") << json_string(near_cut[k].first) << ": " << near_cut[k].second;
+        out << "}, ";
+    }
+    out << "\"gouraud_differences\": {";
+    for (size_t k = 0; k < differences.size(); k++)
+        out << (k ? ", " : "") << json_string(differences[k].first) << ": " << differences[k].second;
+    out << "}";
+    if (name == "mesh") out << ", \"overlaps\": " << overlaps << ", \"holes\": " << holes;
+    out << "}\n"
+        << "    }";
+    return ok;
+}
+
+bool parse_list(const char* s, vector<int>& v)
+{
+    v.clear();
+    stringstream in(s);
+    string item;
+    while (getline(in, item, ',')) {
+        int n = atoi(item.c_str());
+        if (n < 1) return false;
+        v.push_back(n);
+    }
+    return !v.empty();
+}
+
+void usage()
+{
+    cerr << "Usage:  bench [options]\n"
+         << "  --scenes S,...     triangle sets: tiny, slivers, screen, random, mesh, huge (default all)\n"
+         << "  --res WxH          viewport (default 1024x768)\n"
+         << "  --threads N,...    thread counts of the batch runs (default 1 and all hardware threads)\n"
+         << "  --tile N           batch tile size (default 64)\n"
+         << "  --repeat N         report the fastest of N runs (default 3)\n"
+         << "  --seed N           random seed of the scenes (default 1)\n"
+         << "  --label S          stored in the JSON, e.g. the commit benchmarked\n"
+         << "  -o FILE            write the JSON to FILE instead of stdout\n";
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    Settings set;
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        bool more = a + 1 < argc;
+        if (arg == "--scenes" && more) {
+            set.scenes.clear();
+            stringstream in(argv[++a]);
+            string name;
+            TriangleBatch probe;
+            while (getline(in, name, ',')) {
+                if (!make_scene(name, 1, 1, 0, probe)) usage();
+                set.scenes.push_back(name);
+            }
+        }
+        else if (arg == "--res" && more) {
+            if (sscanf(argv[++a], "%dx%d", &set.width, &set.height) != 2 || set.width < 1 || set.height < 1)
+                usage();
+            if (set.width > GUARD_BAND || set.height > GUARD_BAND) {
+                cerr << "bench: --res is at most " << GUARD_BAND << " pixels each way (the guard band, clip.h)" << endl;
+                exit(1);
+            }
+        }
+        else if (arg == "--threads" && more) {
+            if (!parse_list(argv[++a], set.threads)) usage();
+        }
+        else if (arg == "--tile" && more) {
+            set.tile = atoi(argv[++a]);
+            if (set.tile < 1) usage();
+        }
+        else if (arg == "--repeat" && more) {
+            set.repeat = atoi(argv[++a]);
+            if (set.repeat < 1) usage();
+        }
+        else if (arg == "--seed" && more)
+            set.seed = (unsigned) atoi(argv[++a]);
+        else if (arg == "--label" && more)
+            set.label = argv[++a];
+        else if (arg == "-o" && more)
+            set.out = argv[++a];
+        else
+            usage();
+    }
+    if (set.threads.empty()) {
+        set.threads.push_back(1);
+        if (hardware_threads() > 1) set.threads.push_back(hardware_threads());
+    }
+
+    ofstream file;
+    if (!set.out.empty()) {
+        file.open(set.out);
+        if (!file) {
+            cerr << "bench: cannot open " << set.out << endl;
+            exit(1);
+        }
+    }
+    ostream& out = set.out.empty() ? cout : file;
+    vector<string> ks = kernels();
+    out << "{\n"
+        << "  \"label\": " << json_string(set.label) << ",\n"
+        << "  \"kernels\": [";
+    for (size_t k = 0; k < ks.size(); k++)
+        out << (k ? ", " : "") << json_string(ks[k]);
+    out << "],\n"
+        << "  \"width\": " << set.width << ", \"height\": " << set.height << ",\n"
+        << "  \"hardware_threads\": " << hardware_threads() << ",\n"
+        << "  \"repeat\": " << set.repeat << ",\n"
+        << "  \"scenes\": [\n";
+    bool ok = true;
+    for (size_t s = 0; s < set.scenes.size(); s++) {
+        ok = run_scene(set, set.scenes[s], out) && ok;
+        out << (s + 1 < set.scenes.size() ? ",\n" : "\n");
+        out.flush();
+    }
+    PerspectiveCheck persp = check_perspective();
+    if (!persp.ok())
+        cerr << "bench: perspective-correct interpolation differs from the exact value" << endl;
+    out << "  ],\n"
+        << "  \"coverage_ok\": " << (ok ? "true" : "false") << ",\n"
+        << "  \"perspective\": {\"ok\": " << (persp.ok() ? "true" : "false") << ", \"pixels\": " << persp.pixels
+        << ", \"max_error\": " << persp.error << ", \"affine_max_error\": " << persp.affine_error
+        << ", \"affine_drift\": " << persp.affine_drift << "}\n"
+        << "}\n";
+    return ok && persp.ok() ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "clip.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+__extension__ typedef __int128 int128;
+
+struct ClipVertex
+{
+    long long x, y;
+};
+
+// The sides of the band, as "inside" tests on one coordinate. Edges are cut
+// with their ends in a fixed order, so an edge shared by two triangles is
+// cut at the same rounded point for both and they stay watertight.
+struct Side
+{
+    bool x;           // cuts x (else y)
+    long long bound;
+    bool below;       // inside is <= bound (else >= bound)
+
+    long long along(const ClipVertex& v) const { return x ? v.x : v.y; }
+    long long across(const ClipVertex& v) const { return x ? v.y : v.x; }
+    bool inside(const ClipVertex& v) const { return below ? along(v) <= bound : along(v) >= bound; }
+
+    ClipVertex cut(ClipVertex a, ClipVertex b) const
+    {
+        if (b.x < a.x || (b.x == a.x && b.y < a.y)) std::swap(a, b);
+        double t = (double) (bound - along(a)) / (double) (along(b) - along(a));
+        long long c = across(a) + std::llround(t * (double) (across(b) - across(a)));
+        ClipVertex v;
+        if (x) {
+            v.x = bound;
+            v.y = c;
+        }
+        else {
+            v.x = c;
+            v.y = bound;
+        }
+        return v;
+    }
+};
+
+// A pass keeps the i of n vertices inside the side and adds one for every
+// edge that crosses it. Such an edge has one end outside, and each
+// outside vertex ends two edges, so at most min(n, 2 (n - i)) edges
+// cross and a pass leaves at most 3n / 2 vertices. This does not rely on
+// the polygon being convex, which the rounded cut points may spoil: the
+// 4 sides take a triangle to at most 3, 4, 6, 9, 13 vertices.
+constexpr int max_vertices(int n, int sides)
+{
+    return sides == 0 ? n : max_vertices(n * 3 / 2, sides - 1);
+}
+
+const int MAX_POLYGON = max_vertices(3, 4);
+static_assert(MAX_POLYGON - 2 <= MAX_CLIPPED, "the fan of a clipped triangle must fit in MAX_CLIPPED");
+
+// Sutherland-Hodgman: the part of polygon in (n vertices) inside s, at
+// most 3n / 2 vertices
+int clip_polygon(const Side& s, const ClipVertex* in, int n, ClipVertex* out)
+{
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+        const ClipVertex& a = in[k];
+        const ClipVertex& b = in[(k + 1) % n];
+        bool ia = s.inside(a), ib = s.inside(b);
+        if (ia) out[m++] = a;
+        if (ia != ib) out[m++] = s.cut(a, b);
+    }
+    return m;
+}
+
+}
+
+int clip_triangle(const Point p[3], int width, int height, ClippedTriangle out[MAX_CLIPPED])
+{
+    // the band must hold the viewport, or its far side is cut away
+    assert(width <= GUARD_BAND && height <= GUARD_BAND);
+    int xmin = std::min(std::min(p[0].x, p[1].x), p[2].x), xmax = std::max(std::max(p[0].x, p[1].x), p[2].x);
+    int ymin = std::min(std::min(p[0].y, p[1].y), p[2].y), ymax = std::max(std::max(p[0].y, p[1].y), p[2].y);
+    if (xmax < 0 || ymax < 0 || xmin >= width || ymin >= height) return 0;
+
+    if (xmin >= -GUARD_BAND && ymin >= -GUARD_BAND && xmax < GUARD_BAND && ymax < GUARD_BAND) {
+        if (!setup_triangle(p, width, height, out[0].setup)) return 0;
+        out[0].whole = true;
+        for (int k = 0; k < 3; k++)
+            for (int j = 0; j < 3; j++)
+                out[0].weights[k][j] = k == j ? 1.0f : 0.0f;
+        return 1;
+    }
+
+    int128 area = (int128) ((long long) p[1].x - p[0].x) * ((long long) p[2].y - p[0].y) -
+           (int128) ((long long) p[1].y - p[0].y) * ((long long) p[2].x - p[0].x);
+    if (area == 0) return 0;
+
+    ClipVertex a[MAX_POLYGON], b[MAX_POLYGON];
+    int n = 3;
+    for (int k = 0; k < 3; k++) {
+        a[k].x = p[k].x;
+        a[k].y = p[k].y;
+    }
+    const Side sides[4] = { { true, -GUARD_BAND, false }, { true, GUARD_BAND - 1, true },
+                            { false, -GUARD_BAND, false }, { false, GUARD_BAND - 1, true } };
+    for (int s = 0; s < 4 && n > 0; s += 2) {
+        n = clip_polygon(sides[s], a, n, b);
+        n = clip_polygon(sides[s + 1], b, n, a);
+    }
+
+    int count = 0;
+    for (int k = 1; k + 1 < n; k++) {
+        const ClipVertex* v[3] = { &a[0], &a[k], &a[k + 1] };
+        Point q[3];
+        for (int j = 0; j < 3; j++)
+            q[j] = Point((int) v[j]->x, (int) v[j]->y);
+        ClippedTriangle& t = out[count];
+        if (!setup_triangle(q, width, height, t.setup)) continue;
+        t.whole = false;
+        // barycentric weights of the new vertices in the input, from
+        // its edge functions (doubles: the products need up to 66 bits)
+        for (int j = 0; j < 3; j++) {
+            double e[3], sum = 0;
+            for (int i = 0; i < 3; i++) {
+                const Point& pa = p[(i + 1) % 3];
+                const Point& pb = p[(i + 2) % 3];
+                e[i] = ((double) pb.x - pa.x) * ((double) v[j]->y - pa.y) -
+                       ((double) pb.y - pa.y) * ((double) v[j]->x - pa.x);
+                sum += e[i];
+            }
+            for (int i = 0; i < 3; i++)
+                t.weights[j][i] = (float) (e[i] / sum);
+        }
+        count++;
+    }
+    return count;
+}
+
+bool clip_line(int& x0, int& y0, int& x1, int& y1)
+{
+    const double lo = -GUARD_BAND, hi = GUARD_BAND - 1;
+    if (x0 >= lo && x0 <= hi && y0 >= lo && y0 <= hi && x1 >= lo && x1 <= hi && y1 >= lo && y1 <= hi)
+        return true;
+
+    // Liang-Barsky: the part of the line p0 + t (p1 - p0), t in [0, 1], inside
+    double dx = (double) x1 - x0, dy = (double) y1 - y0;
+    double t0 = 0, t1 = 1;
+    const double p[4] = { -dx, dx, -dy, dy };
+    const double q[4] = { x0 - lo, hi - x0, y0 - lo, hi - y0 };
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0) {
+            if (q[k] < 0) return false;
+            continue;
+        }
+        double t = q[k] / p[k];
+        if (p[k] < 0) t0 = std::max(t0, t);
+        else t1 = std::min(t1, t);
+        if (t0 > t1) return false;
+    }
+    double ax = x0, ay = y0;
+    x0 = (int) std::min(std::max(std::round(ax + t0 * dx), lo), hi);
+    y0 = (int) std::min(std::max(std::round(ay + t0 * dy), lo), hi);
+    x1 = (int) std::min(std::max(std::round(ax + t1 * dx), lo), hi);
+    y1 = (int) std::min(std::max(std::round(ay + t1 * dy), lo), hi);
+    return true;
+}
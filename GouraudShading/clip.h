@@ -0,0 +1,64 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include "raster.h"
+
+// Guard-band clipping.
+//
+// setup_triangle() and the fill kernels evaluate the edge functions in
+// 32-bit integers, which is exact while the vertex coordinates span less
+// than 32768 pixels. The guard band is the square [-GUARD_BAND,
+// GUARD_BAND) around the origin, which holds the viewport. A triangle
+// inside it is set up as it is: only its scan bounds are clamped to the
+// viewport, so a large, partly visible triangle costs its visible box. A
+// triangle that reaches outside the band, which is rare, is first cut to
+// the band geometrically. The new vertices are rounded to whole pixels.
+// On an edge from a vertex inside the band to one far outside, that moves
+// the visible part by a small fraction of a pixel (the rounding shrinks
+// by the ratio of the distances from the inner vertex); an edge cut at
+// both ends can move by up to half a pixel. Edges shared by two
+// triangles are cut at the same points, so meshes stay watertight.
+
+const int GUARD_BAND = 16384;
+
+// cutting a triangle by the 4 sides of the band leaves at most 7
+// vertices, 5 triangles, but the rounded cut points can bend the polygon;
+// MAX_CLIPPED is the bound that holds whatever its shape (see clip.cxx)
+const int MAX_CLIPPED = 11;
+
+struct ClippedTriangle
+{
+    TriangleSetup setup;
+    bool whole;             // the input triangle itself, weights the identity
+    float weights[3][3];    // vertex k is sum of weights[k][j] * input vertex j
+};
+
+// Sets up triangle p, with any coordinates, for the viewport [0, width) x
+// [0, height) (at most GUARD_BAND each way). Returns 0 without any
+// per-pixel work if it has no area or is outside the viewport; 1 with
+// the triangle itself in out[0] (weights the identity) if it is inside
+// the guard band; else the number of triangles it was cut into.
+int clip_triangle(const Point p[3], int width, int height, ClippedTriangle out[MAX_CLIPPED]);
+
+// vertex k of a clipped triangle, from the vertex colors c of the input
+inline Color clipped_color(const ClippedTriangle& t, int k, const Color c[3])
+{
+    if (t.whole) return c[k];
+    const float* w = t.weights[k];
+    return Color(w[0] * c[0].r + w[1] * c[1].r + w[2] * c[2].r,
+                 w[0] * c[0].g + w[1] * c[1].g + w[2] * c[2].g,
+                 w[0] * c[0].b + w[1] * c[1].b + w[2] * c[2].b);
+}
+
+inline float clipped_value(const ClippedTriangle& t, int k, const float v[3])
+{
+    if (t.whole) return v[k];
+    const float* w = t.weights[k];
+    return w[0] * v[0] + w[1] * v[1] + w[2] * v[2];
+}
+
+// Cuts the line from (x0, y0) to (x1, y1) to the guard band, rounding the
+// new ends; false if none of it is inside.
+bool clip_line(int& x0, int& y0, int& x1, int& y1);
+
+#endif
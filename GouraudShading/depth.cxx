@@ -0,0 +1,133 @@
+#include "depth.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+
+// more than the rounding error of an interpolated depth, so the tile
+// tests never drop a pixel the per-pixel test would draw, nor draw one it
+// would drop
+const float Z_SLACK = 1e-5f;
+
+enum TileTest { HIDDEN, FRONT, TEST };
+
+inline TileTest tile_test(const DepthBuffer& db, int k, float zmin, float zmax)
+{
+    if (zmin - Z_SLACK >= db.tile_max[k]) return HIDDEN;
+    if (zmax + Z_SLACK < db.tile_min[k]) return FRONT;
+    return TEST;
+}
+
+}
+
+void DepthBuffer::resize(int w, int h)
+{
+    width = w;
+    height = h;
+    tx = (w + TILE - 1) / TILE;
+    ty = (h + TILE - 1) / TILE;
+    z.resize((size_t) w * h);
+    tile_min.resize((size_t) tx * ty);
+    tile_max.resize((size_t) tx * ty);
+}
+
+void DepthBuffer::clear(float far)
+{
+    std::fill(z.begin(), z.end(), far);
+    std::fill(tile_min.begin(), tile_min.end(), far);
+    std::fill(tile_max.begin(), tile_max.end(), far);
+}
+
+void DepthStats::add(const DepthStats& s)
+{
+    culled += s.culled;
+    tiles_culled += s.tiles_culled;
+    tiles_accepted += s.tiles_accepted;
+    tested += s.tested;
+    shaded += s.shaded;
+}
+
+void fill_gouraud_depth(const TriangleSetup& t, const Color c[3], const float z[3],
+                        Framebuffer& fb, DepthBuffer& db, DepthStats& st)
+{
+    const int T = DepthBuffer::TILE;
+    float zmin = std::min(std::min(z[0], z[1]), z[2]);
+    float zmax = std::max(std::max(z[0], z[1]), z[2]);
+    int i0 = t.xmin / T, i1 = t.xmax / T, j0 = t.ymin / T, j1 = t.ymax / T;
+
+    if (db.hierarchical) {
+        bool hidden = true;
+        for (int j = j0; j <= j1 && hidden; j++)
+            for (int i = i0; i <= i1 && hidden; i++)
+                hidden = tile_test(db, j * db.tx + i, zmin, zmax) == HIDDEN;
+        if (hidden) {
+            st.culled++;
+            st.tiles_culled += (long long) (i1 - i0 + 1) * (j1 - j0 + 1);
+            return;
+        }
+    }
+
+    float inv = 1.0f / t.area;
+    int b0 = t.e[0].bias, b1 = t.e[1].bias, b2 = t.e[2].bias;
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            int k = j * db.tx + i;
+            TileTest test = db.hierarchical ? tile_test(db, k, zmin, zmax) : TEST;
+            if (test == HIDDEN) {
+                st.tiles_culled++;
+                continue;
+            }
+            if (test == FRONT) st.tiles_accepted++;
+
+            TriangleSetup r;
+            if (!restrict_setup(t, i * T, j * T, i * T + T - 1, j * T + T - 1, r)) continue;
+            float written = FLT_MAX, written_far = 0;   // nearest and farthest written
+            int count = 0;
+            int r0 = r.e[0].w, r1 = r.e[1].w, r2 = r.e[2].w;
+            for (int y = r.ymin; y <= r.ymax; y++) {
+                float* zrow = &db.z[(size_t) y * db.width];
+                int w0 = r0, w1 = r1, w2 = r2;
+                for (int x = r.xmin; x <= r.xmax; x++) {
+                    if ((w0 | w1 | w2) >= 0) {
+                        float l0 = (w0 + b0) * inv, l1 = (w1 + b1) * inv, l2 = (w2 + b2) * inv;
+                        float d = l0 * z[0] + l1 * z[1] + l2 * z[2];
+                        if (test == TEST) st.tested++;
+                        if (test == FRONT || d < zrow[x]) {
+                            zrow[x] = d;
+                            written = std::min(written, d);
+                            written_far = std::max(written_far, d);
+                            count++;
+                            fb.set(x, y, Color(l0 * c[0].r + l1 * c[1].r + l2 * c[2].r,
+                                               l0 * c[0].g + l1 * c[1].g + l2 * c[2].g,
+                                               l0 * c[0].b + l1 * c[1].b + l2 * c[2].b));
+                            st.shaded++;
+                        }
+                    }
+                    w0 += r.e[0].dx;
+                    w1 += r.e[1].dx;
+                    w2 += r.e[2].dx;
+                }
+                r0 += r.e[0].dy;
+                r1 += r.e[1].dy;
+                r2 += r.e[2].dy;
+            }
+
+            // the nearest depth can only have come closer; the farthest
+            // is the farthest written if every pixel of the tile was,
+            // else it has to be found again
+            if (written == FLT_MAX || !db.hierarchical) continue;
+            db.tile_min[k] = std::min(db.tile_min[k], written);
+            int x1 = std::min(i * T + T, db.width), y1 = std::min(j * T + T, db.height);
+            if (count == (x1 - i * T) * (y1 - j * T)) {
+                db.tile_max[k] = written_far;
+                continue;
+            }
+            float far = 0;
+            for (int y = j * T; y < y1; y++)
+                for (int x = i * T; x < x1; x++)
+                    far = std::max(far, db.z[(size_t) y * db.width + x]);
+            db.tile_max[k] = far;
+        }
+    }
+}
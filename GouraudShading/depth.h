@@ -0,0 +1,52 @@
+#ifndef DEPTH_H
+#define DEPTH_H
+
+#include <vector>
+#include "raster.h"
+#include "framebuffer.h"
+
+// Depth buffer with a coarse level of 8x8-pixel tiles.
+//
+// Depths are in [0, 1] and smaller is nearer; a pixel is drawn if it is
+// nearer than the depth stored for it. Every tile keeps the nearest and
+// the farthest depth stored in it. A triangle whose nearest depth is at
+// or behind a tile's farthest is hidden in that whole tile, and one whose
+// farthest depth is in front of a tile's nearest is visible wherever it
+// covers the tile, so neither needs a depth test per pixel.
+struct DepthBuffer
+{
+    static const int TILE = 8;
+
+    int width = 0, height = 0;
+    int tx = 0, ty = 0;                       // tiles across and down
+    std::vector<float> z;                     // per pixel, row by row
+    std::vector<float> tile_min, tile_max;    // per tile, row by row
+    bool hierarchical = true;                 // false: a plain z-buffer
+
+    void resize(int width, int height);
+    // every pixel (and tile) at depth far
+    void clear(float far = 1);
+};
+
+struct DepthStats
+{
+    long long culled = 0;            // triangles hidden in every tile they touch (a
+                                     // batch counts each screen tile of a triangle)
+    long long tiles_culled = 0;      // (triangle, tile) pairs hidden
+    long long tiles_accepted = 0;    // (triangle, tile) pairs in front of the whole tile
+    long long tested = 0;            // covered pixels that were depth tested
+    long long shaded = 0;            // pixels that passed and were shaded
+
+    void add(const DepthStats& s);
+};
+
+// Gouraud fill with a depth test; the vertex depths z are interpolated
+// like the colors c. With db.hierarchical, the triangle is first checked
+// against the tiles it touches and dropped if it is hidden in all of
+// them; then hidden tiles are skipped and tiles it is in front of are
+// drawn without reading the depths. The pixels drawn are the same either
+// way.
+void fill_gouraud_depth(const TriangleSetup& t, const Color c[3], const float z[3],
+                        Framebuffer& fb, DepthBuffer& db, DepthStats& st);
+
+#endif
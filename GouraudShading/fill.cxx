@@ -0,0 +1,158 @@
+#include "fill.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void flat_scalar(const TriangleSetup& t, const Color& color, Framebuffer& fb)
+{
+    rasterize_flat(t, color, FramebufferPlot(fb));
+}
+
+void gouraud_scalar(const TriangleSetup& t, const Color c[3], Framebuffer& fb)
+{
+    rasterize_gouraud(t, c, FramebufferPlot(fb));
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// The edge functions of the 8 pixels (x, y) ... (x + 7, y) are held in
+// one vector per edge; w[k] starts a row at E_k(xmin, y) + lane * dx and
+// steps by 8 * dx per block.
+struct EdgeBlocks
+{
+    __m256i lane_dx[3], step[3];
+};
+
+__attribute__((target("avx2")))
+inline void setup_blocks(const TriangleSetup& t, EdgeBlocks& b)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int k = 0; k < 3; k++) {
+        b.lane_dx[k] = _mm256_mullo_epi32(lane, _mm256_set1_epi32(t.e[k].dx));
+        b.step[k] = _mm256_set1_epi32(8 * t.e[k].dx);
+    }
+}
+
+// lanes whose pixel is inside all three edges and at most xmax - x to the
+// right, i.e. still in the box
+__attribute__((target("avx2")))
+inline __m256i block_mask(__m256i w0, __m256i w1, __m256i w2, int left)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i inside = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(w0, w1), w2), _mm256_set1_epi32(-1));
+    return _mm256_and_si256(inside, _mm256_cmpgt_epi32(_mm256_set1_epi32(left), lane));
+}
+
+// Framebuffer::to_byte() of every lane, shifted into place
+__attribute__((target("avx2")))
+inline __m256i to_bytes(__m256 v, int shift)
+{
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1));
+    __m256i b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255)), _mm256_set1_ps(0.5f)));
+    return _mm256_slli_epi32(b, shift);
+}
+
+__attribute__((target("avx2")))
+void flat_avx2(const TriangleSetup& t, const Color& color, Framebuffer& fb)
+{
+    EdgeBlocks b;
+    setup_blocks(t, b);
+    const __m256i pixel = _mm256_set1_epi32((int) Framebuffer::pack(color));
+
+    int r0 = t.e[0].w, r1 = t.e[1].w, r2 = t.e[2].w;
+    for (int y = t.ymin; y <= t.ymax; y++) {
+        int* row = (int*) fb.row(y);
+        __m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(r0), b.lane_dx[0]);
+        __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(r1), b.lane_dx[1]);
+        __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(r2), b.lane_dx[2]);
+        for (int x = t.xmin; x <= t.xmax; x += 8) {
+            __m256i mask = block_mask(w0, w1, w2, t.xmax - x + 1);
+            if (!_mm256_testz_si256(mask, mask))
+                _mm256_maskstore_epi32(row + x, mask, pixel);
+            w0 = _mm256_add_epi32(w0, b.step[0]);
+            w1 = _mm256_add_epi32(w1, b.step[1]);
+            w2 = _mm256_add_epi32(w2, b.step[2]);
+        }
+        r0 += t.e[0].dy;
+        r1 += t.e[1].dy;
+        r2 += t.e[2].dy;
+    }
+}
+
+__attribute__((target("avx2")))
+void gouraud_avx2(const TriangleSetup& t, const Color c[3], Framebuffer& fb)
+{
+    EdgeBlocks b;
+    setup_blocks(t, b);
+    const __m256 inv = _mm256_set1_ps(1.0f / t.area);
+    const __m256i b0 = _mm256_set1_epi32(t.e[0].bias);
+    const __m256i b1 = _mm256_set1_epi32(t.e[1].bias);
+    const __m256i b2 = _mm256_set1_epi32(t.e[2].bias);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xff000000u);
+    __m256 cr[3], cg[3], cb[3];
+    for (int k = 0; k < 3; k++) {
+        cr[k] = _mm256_set1_ps(c[k].r);
+        cg[k] = _mm256_set1_ps(c[k].g);
+        cb[k] = _mm256_set1_ps(c[k].b);
+    }
+
+    int r0 = t.e[0].w, r1 = t.e[1].w, r2 = t.e[2].w;
+    for (int y = t.ymin; y <= t.ymax; y++) {
+        int* row = (int*) fb.row(y);
+        __m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(r0), b.lane_dx[0]);
+        __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(r1), b.lane_dx[1]);
+        __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(r2), b.lane_dx[2]);
+        for (int x = t.xmin; x <= t.xmax; x += 8) {
+            __m256i mask = block_mask(w0, w1, w2, t.xmax - x + 1);
+            if (!_mm256_testz_si256(mask, mask)) {
+                __m256 l0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(w0, b0)), inv);
+                __m256 l1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(w1, b1)), inv);
+                __m256 l2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(w2, b2)), inv);
+                __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(l0, cr[0]), _mm256_mul_ps(l1, cr[1])),
+                                         _mm256_mul_ps(l2, cr[2]));
+                __m256 g = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(l0, cg[0]), _mm256_mul_ps(l1, cg[1])),
+                                         _mm256_mul_ps(l2, cg[2]));
+                __m256 bl = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(l0, cb[0]), _mm256_mul_ps(l1, cb[1])),
+                                          _mm256_mul_ps(l2, cb[2]));
+                __m256i pixel = _mm256_or_si256(_mm256_or_si256(to_bytes(r, 0), to_bytes(g, 8)),
+                                                _mm256_or_si256(to_bytes(bl, 16), alpha));
+                _mm256_maskstore_epi32(row + x, mask, pixel);
+            }
+            w0 = _mm256_add_epi32(w0, b.step[0]);
+            w1 = _mm256_add_epi32(w1, b.step[1]);
+            w2 = _mm256_add_epi32(w2, b.step[2]);
+        }
+        r0 += t.e[0].dy;
+        r1 += t.e[1].dy;
+        r2 += t.e[2].dy;
+    }
+}
+
+#endif
+
+}
+
+FlatFill fill_flat = flat_scalar;
+GouraudFill fill_gouraud = gouraud_scalar;
+
+std::string select_fill(const std::string& name)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if ((name == "auto" || name == "avx2") && __builtin_cpu_supports("avx2")) {
+        fill_flat = flat_avx2;
+        fill_gouraud = gouraud_avx2;
+        return "avx2";
+    }
+#endif
+    if (name == "auto" || name == "scalar") {
+        fill_flat = flat_scalar;
+        fill_gouraud = gouraud_scalar;
+        return "scalar";
+    }
+    return "";
+}
@@ -0,0 +1,31 @@
+#ifndef FILL_H
+#define FILL_H
+
+#include <string>
+#include "raster.h"
+#include "framebuffer.h"
+
+// Kernels that fill a set-up triangle straight into a framebuffer.
+//
+// The scalar kernels are rasterize_flat() and rasterize_gouraud() with a
+// FramebufferPlot. The AVX2 kernels step the edge functions for blocks of
+// 8 pixels of a row at once: the sign bits of the three edge functions
+// give the coverage mask of the block, blocks with no pixel inside are
+// skipped, and the colors of all 8 pixels are interpolated and written
+// with one masked store. They evaluate the same expressions in the same
+// order as the scalar kernels, without fused multiply-adds, so every
+// kernel writes the same pixels with the same bytes.
+
+typedef void (*FlatFill)(const TriangleSetup& t, const Color& color, Framebuffer& fb);
+typedef void (*GouraudFill)(const TriangleSetup& t, const Color c[3], Framebuffer& fb);
+
+// the kernels in use, picked by select_fill()
+extern FlatFill fill_flat;
+extern GouraudFill fill_gouraud;
+
+// Picks the AVX2 kernels if the CPU supports them ("auto"), or the named
+// ones ("scalar", "avx2"). Returns the name of the kernels selected, or
+// an empty string if the named ones are unknown or not supported.
+std::string select_fill(const std::string& name = "auto");
+
+#endif
@@ -0,0 +1,64 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include "clip.h"
+
+Framebuffer::Framebuffer(int width, int height)
+    : width(0), height(0)
+{
+    resize(width, height);
+}
+
+void Framebuffer::resize(int w, int h)
+{
+    width = w;
+    height = h;
+    pixels.resize((std::size_t) w * h);
+}
+
+void Framebuffer::clear(const Color& c)
+{
+    std::fill(pixels.begin(), pixels.end(), pack(c));
+}
+
+void draw_line(Framebuffer& fb, int x0, int y0, int x1, int y1, const Color& c)
+{
+    // far ends would overflow the error terms and take as many steps
+    if (!clip_line(x0, y0, x1, y1)) return;
+    int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        if (x0 >= 0 && x0 < fb.width && y0 >= 0 && y0 < fb.height)
+            fb.set(x0, y0, c);
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+bool write_ppm(const char* path, const Framebuffer& fb)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << fb.width << " " << fb.height << "\n255\n";
+    std::vector<unsigned char> rgb((std::size_t) fb.width * 3);
+    for (int y = 0; y < fb.height; y++) {
+        const uint32_t* p = fb.row(y);
+        for (int x = 0; x < fb.width; x++) {
+            rgb[3 * x] = (unsigned char) p[x];
+            rgb[3 * x + 1] = (unsigned char) (p[x] >> 8);
+            rgb[3 * x + 2] = (unsigned char) (p[x] >> 16);
+        }
+        out.write((const char*) &rgb[0], rgb.size());
+    }
+    return !out.fail();
+}
@@ -0,0 +1,63 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+#include "raster.h"
+
+// In-memory 8-bit RGB image that the rasterizer draws into. Row 0 is the
+// top row, the same as window (mouse) coordinates and PPM files.
+//
+// A pixel is one 32-bit word, bytes R, G, B, A in memory (A is always
+// 255), so SIMD kernels can write 8 pixels with one masked store and the
+// window can show it as GL_RGBA. Assumes a little-endian host.
+struct Framebuffer
+{
+    int width;
+    int height;
+    std::vector<uint32_t> pixels;   // row by row
+
+    Framebuffer(int width = 0, int height = 0);
+
+    // resizes to width x height, contents undefined
+    void resize(int width, int height);
+    void clear(const Color& c);
+
+    // pixel (x, y), which must be inside
+    void set(int x, int y, const Color& c)
+    {
+        pixels[(std::size_t) y * width + x] = pack(c);
+    }
+
+    uint32_t* row(int y) { return &pixels[(std::size_t) y * width]; }
+    const uint32_t* row(int y) const { return &pixels[(std::size_t) y * width]; }
+
+    static uint32_t pack(const Color& c)
+    {
+        return to_byte(c.r) | (uint32_t) to_byte(c.g) << 8 | (uint32_t) to_byte(c.b) << 16 | 0xff000000u;
+    }
+
+    static unsigned char to_byte(float v)
+    {
+        return (unsigned char) ((v < 0 ? 0 : v > 1 ? 1 : v) * 255 + 0.5f);
+    }
+};
+
+// plot function for rasterize_flat() and rasterize_gouraud()
+struct FramebufferPlot
+{
+    Framebuffer* fb;
+    FramebufferPlot(Framebuffer& fb) : fb(&fb) {}
+    void operator()(int x, int y, const Color& c) const { fb->set(x, y, c); }
+};
+
+// Bresenham line from (x0, y0) to (x1, y1), both ends included; pixels
+// outside the framebuffer are skipped, ends outside the guard band
+// (clip.h) are cut to it first
+void draw_line(Framebuffer& fb, int x0, int y0, int x1, int y1, const Color& c);
+
+// writes fb as a binary PPM (P6, alpha dropped); false if the file could not be written
+bool write_ppm(const char* path, const Framebuffer& fb);
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef INTERPOLATE_H
+#define INTERPOLATE_H
+
+#include "raster.h"
+#include "clip.h"
+
+// Perspective-correct interpolation of per-vertex attributes (varyings)
+// whose set is fixed at compile time.
+//
+// A layout lists the attributes of a vertex,
+//
+//     typedef Layout<ColorAttr, UVAttr, NormalAttr, DepthAttr> Shaded;
+//
+// and Varyings<Shaded> holds their Shaded::size floats one after the
+// other; v.get<UVAttr>() points to the two floats of the UV. The layout
+// is a template argument of rasterize_varyings(), so the loops over the
+// attributes have constant trip counts, are unrolled by template
+// recursion, and whether an attribute is corrected for perspective is
+// decided at compile time. A layout costs one multiply-add chain per
+// float and nothing else.
+//
+// Attributes are linear in eye space, not on the screen: a value a
+// interpolates as (a / w) / (1 / w), where w is the vertex's clip-space
+// w, since both a / w and 1 / w are linear on the screen. With the
+// screen weights l_k and q_k = l_k / w_k, the corrected weights are
+// q_k / (q_0 + q_1 + q_2), so a pixel needs one division, however many
+// attributes there are. The depth a z-buffer compares, z / w, is already
+// linear on the screen and is interpolated with l_k.
+
+// N floats; interpolated with the corrected weights if Perspective
+template <int N, bool Perspective = true>
+struct Attribute
+{
+    static const int size = N;
+    static const bool perspective = Perspective;
+};
+
+struct ColorAttr : Attribute<3> {};
+struct UVAttr : Attribute<2> {};
+struct NormalAttr : Attribute<3> {};
+struct DepthAttr : Attribute<1, false> {};    // z / w
+
+template <class... A> struct Layout;
+
+template <>
+struct Layout<>
+{
+    static const int size = 0;
+    static const bool perspective = false;    // true if any attribute is
+};
+
+template <class First, class... Rest>
+struct Layout<First, Rest...>
+{
+    typedef First head;
+    typedef Layout<Rest...> tail;
+    static const int size = First::size + tail::size;
+    static const bool perspective = First::perspective || tail::perspective;
+};
+
+// index of the first float of attribute A in layout L
+template <class L, class A> struct AttributeOffset;
+
+template <class A, class... Rest>
+struct AttributeOffset<Layout<A, Rest...>, A>
+{
+    static const int value = 0;
+};
+
+template <class B, class... Rest, class A>
+struct AttributeOffset<Layout<B, Rest...>, A>
+{
+    static const int value = B::size + AttributeOffset<Layout<Rest...>, A>::value;
+};
+
+template <class L>
+struct Varyings
+{
+    static_assert(L::size > 0, "a layout needs at least one attribute");
+    float v[L::size];
+
+    template <class A> float* get() { return v + AttributeOffset<L, A>::value; }
+    template <class A> const float* get() const { return v + AttributeOffset<L, A>::value; }
+};
+
+namespace interpolate_detail {
+
+// out[I, N) = l[0] * a[I, N) + l[1] * b[I, N) + l[2] * c[I, N)
+template <int I, int N>
+struct Lerp
+{
+    static void run(float* out, const float* a, const float* b, const float* c, const float* l)
+    {
+        out[I] = l[0] * a[I] + l[1] * b[I] + l[2] * c[I];
+        Lerp<I + 1, N>::run(out, a, b, c, l);
+    }
+};
+
+template <int N>
+struct Lerp<N, N>
+{
+    static void run(float*, const float*, const float*, const float*, const float*) {}
+};
+
+template <bool Perspective> struct Weights;
+template <> struct Weights<false> { static const float* pick(const float* l, const float*) { return l; } };
+template <> struct Weights<true> { static const float* pick(const float*, const float* p) { return p; } };
+
+// interpolates the attributes of L, which start at float Offset
+template <class L, int Offset = 0>
+struct LerpLayout
+{
+    typedef typename L::head A;
+
+    static void run(float* out, const float* a, const float* b, const float* c,
+                    const float* linear, const float* corrected)
+    {
+        Lerp<Offset, Offset + A::size>::run(out, a, b, c, Weights<A::perspective>::pick(linear, corrected));
+        LerpLayout<typename L::tail, Offset + A::size>::run(out, a, b, c, linear, corrected);
+    }
+};
+
+template <int Offset>
+struct LerpLayout<Layout<>, Offset>
+{
+    static void run(float*, const float*, const float*, const float*, const float*, const float*) {}
+};
+
+// the corrected weights, only computed if some attribute uses them
+template <bool Perspective>
+struct Corrected
+{
+    static void run(float* p, int e0, int e1, int e2, const float* inv_w)
+    {
+        float q0 = e0 * inv_w[0], q1 = e1 * inv_w[1], q2 = e2 * inv_w[2];
+        float s = 1.0f / (q0 + q1 + q2);
+        p[0] = q0 * s;
+        p[1] = q1 * s;
+        p[2] = q2 * s;
+    }
+};
+
+template <>
+struct Corrected<false>
+{
+    static void run(float*, int, int, int, const float*) {}
+};
+
+}
+
+// Vertex k of a clipped triangle (clip.h): its attributes out and w,
+// from the attributes v and w of the input triangle. Its weights are
+// screen weights, so attributes that are corrected for perspective are
+// mixed with the corrected ones.
+template <class L>
+void clipped_varyings(const ClippedTriangle& t, int k, const Varyings<L> v[3], const float w[3],
+                      Varyings<L>& out, float& out_w)
+{
+    using namespace interpolate_detail;
+    if (t.whole) {
+        out = v[k];
+        out_w = w[k];
+        return;
+    }
+    const float* l = t.weights[k];
+    float q[3] = { l[0] / w[0], l[1] / w[1], l[2] / w[2] };
+    float inv_w = q[0] + q[1] + q[2];
+    float p[3] = { q[0] / inv_w, q[1] / inv_w, q[2] / inv_w };
+    LerpLayout<L>::run(out.v, v[0].v, v[1].v, v[2].v, l, p);
+    out_w = 1.0f / inv_w;
+}
+
+// Calls plot(x, y, varyings) for every pixel of the triangle, with the
+// attributes v of its vertices interpolated. w are the vertices'
+// clip-space w, > 0 (all 1 for a triangle facing the viewer, which makes
+// every attribute interpolate like rasterize_gouraud()).
+template <class L, class Plot>
+void rasterize_varyings(const TriangleSetup& t, const Varyings<L> v[3], const float w[3], Plot plot)
+{
+    using namespace interpolate_detail;
+    float inv = 1.0f / t.area;
+    float inv_w[3] = { 1.0f / w[0], 1.0f / w[1], 1.0f / w[2] };
+    int b0 = t.e[0].bias, b1 = t.e[1].bias, b2 = t.e[2].bias;
+    int r0 = t.e[0].w, r1 = t.e[1].w, r2 = t.e[2].w;
+    Varyings<L> out;
+    for (int y = t.ymin; y <= t.ymax; y++) {
+        int w0 = r0, w1 = r1, w2 = r2;
+        for (int x = t.xmin; x <= t.xmax; x++) {
+            if ((w0 | w1 | w2) >= 0) {
+                float l[3] = { (w0 + b0) * inv, (w1 + b1) * inv, (w2 + b2) * inv };
+                float p[3];
+                Corrected<L::perspective>::run(p, w0 + b0, w1 + b1, w2 + b2, inv_w);
+                LerpLayout<L>::run(out.v, v[0].v, v[1].v, v[2].v, l, p);
+                plot(x, y, out);
+            }
+            w0 += t.e[0].dx;
+            w1 += t.e[1].dx;
+            w2 += t.e[2].dx;
+        }
+        r0 += t.e[0].dy;
+        r1 += t.e[1].dy;
+        r2 += t.e[2].dy;
+    }
+}
+
+#endif
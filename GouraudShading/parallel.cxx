@@ -0,0 +1,71 @@
+#include "parallel.h"
+
+WorkerPool::WorkerPool(int nthreads) : next(0)
+{
+    for (int t = 1; t < nthreads; t++)
+        workers.emplace_back(&WorkerPool::loop, this, t);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> g(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers)
+        w.join();
+}
+
+// runs jobs of the current run until none are left
+void WorkerPool::claim(int thread)
+{
+    for (int k; (k = next.fetch_add(1)) < njobs;)
+        (*job)(k, thread);
+}
+
+// a worker thread: waits for a run, helps with it, and waits again
+void WorkerPool::loop(int thread)
+{
+    long long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> g(lock);
+            wake.wait(g, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+        }
+        claim(thread);
+        std::lock_guard<std::mutex> g(lock);
+        if (--busy == 0) idle.notify_one();
+    }
+}
+
+void WorkerPool::run(int njobs, const std::function<void(int job, int thread)>& job)
+{
+    if (workers.empty() || njobs <= 1) {
+        for (int k = 0; k < njobs; k++)
+            job(k, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(lock);
+        this->job = &job;
+        this->njobs = njobs;
+        next = 0;
+        busy = (int) workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    claim(0);
+    std::unique_lock<std::mutex> g(lock);
+    idle.wait(g, [&] { return busy == 0; });
+}
+
+int hardware_threads()
+{
+    int n = (int) std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
@@ -0,0 +1,59 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The threads the batch rasterizer (batch.h) runs on. A pool is made once
+// per frame or per stream and kept for all of its rasterize_batch()
+// calls, whose front end (one job per chunk of triangles) and back end
+// (one job per screen tile) then reuse the same threads instead of
+// starting new ones for every pass.
+//
+// Jobs are claimed one at a time, in order, from a shared counter. Tiles
+// differ a lot in cost, from empty background to a pile of large
+// triangles, and a thread that is done with its tile simply takes the
+// next one left; claiming costs one atomic add, against the thousands of
+// pixels of a tile. job is called with the index of the thread running
+// it; the thread calling run() is thread 0.
+//
+// A pool of one thread starts none and runs the jobs on the caller, in
+// order. run() must not be called from a job of the same pool.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int nthreads);
+    ~WorkerPool();
+
+    int threads() const { return (int) workers.size() + 1; }
+
+    // runs job(k, thread) for every k in [0, njobs), returns when all are done
+    void run(int njobs, const std::function<void(int job, int thread)>& job);
+
+private:
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+    void claim(int thread);
+    void loop(int thread);
+
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable wake, idle;
+    const std::function<void(int, int)>* job = nullptr;
+    int njobs = 0;
+    std::atomic<int> next;       // next job to claim
+    long long generation = 0;    // runs started
+    int busy = 0;                // workers still on the current run
+    bool stop = false;
+};
+
+// number of hardware threads, at least 1
+int hardware_threads();
+
+#endif
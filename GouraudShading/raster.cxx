@@ -0,0 +1,45 @@
+#include "raster.h"
+
+#include <algorithm>
+
+bool setup_triangle(const Point p[3], int width, int height, TriangleSetup& t)
+{
+    t.xmin = std::max(std::min(std::min(p[0].x, p[1].x), p[2].x), 0);
+    t.ymin = std::max(std::min(std::min(p[0].y, p[1].y), p[2].y), 0);
+    t.xmax = std::min(std::max(std::max(p[0].x, p[1].x), p[2].x), width - 1);
+    t.ymax = std::min(std::max(std::max(p[0].y, p[1].y), p[2].y), height - 1);
+    if (t.xmin > t.xmax || t.ymin > t.ymax) return false;
+
+    t.area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    if (t.area == 0) return false;
+    // clockwise triangles: flip every edge function so inside is >= 0
+    int sign = t.area > 0 ? 1 : -1;
+    t.area *= sign;
+
+    for (int k = 0; k < 3; k++) {
+        const Point& a = p[(k + 1) % 3];
+        const Point& b = p[(k + 2) % 3];
+        Edge& e = t.e[k];
+        e.dx = -sign * (b.y - a.y);
+        e.dy = sign * (b.x - a.x);
+        // a pixel on the edge is drawn by the triangle on the side the
+        // edge's normal (dx, dy) points to first in x, then in y; the
+        // triangle across the edge sees (-dx, -dy) and leaves it out
+        e.bias = e.dx > 0 || (e.dx == 0 && e.dy > 0) ? 0 : 1;
+        e.w = e.dy * (t.ymin - a.y) + e.dx * (t.xmin - a.x) - e.bias;
+    }
+    return true;
+}
+
+bool restrict_setup(const TriangleSetup& t, int x0, int y0, int x1, int y1, TriangleSetup& r)
+{
+    r = t;
+    r.xmin = std::max(t.xmin, x0);
+    r.ymin = std::max(t.ymin, y0);
+    r.xmax = std::min(t.xmax, x1);
+    r.ymax = std::min(t.ymax, y1);
+    if (r.xmin > r.xmax || r.ymin > r.ymax) return false;
+    for (int k = 0; k < 3; k++)
+        r.e[k].w += t.e[k].dx * (r.xmin - t.xmin) + t.e[k].dy * (r.ymin - t.ymin);
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+// Simple structure for a point
+struct Point
+{
+    int x;
+    int y;
+    Point() : x(-1), y(-1) {}
+    Point(int x, int y) : x(x), y(y) {}
+};
+
+struct Color
+{
+    float r;
+    float g;
+    float b;
+
+    Color() : r(0), g(0), b(0) {}
+    Color(float r, float g, float b) : r(r), g(g), b(b) {}
+};
+
+// Half-space (edge function) rasterization.
+//
+// The edge function of the edge from a to b,
+//
+//     E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x),
+//
+// is twice the signed area of the triangle (a, b, p). It is linear in p,
+// so it changes by a constant for every step of one pixel in x or in y.
+// A pixel is inside the triangle when the edge functions of all three
+// edges are >= 0, and E_k / (E_0 + E_1 + E_2), with E_k the edge opposite
+// vertex k, is the barycentric weight of vertex k.
+//
+// Pixels are sampled at integer coordinates, the same coordinates as the
+// vertices, so every value is an exact integer. A pixel exactly on an edge
+// shared by two triangles is drawn by only one of them (the top-left fill
+// rule), so a mesh has no gaps and no pixel drawn twice.
+
+struct Edge
+{
+    int dx, dy;    // change per pixel step in x and in y
+    int w;         // value at (xmin, ymin), minus bias
+    int bias;      // 1 if pixels on this edge belong to the neighbor
+};
+
+struct TriangleSetup
+{
+    int xmin, ymin, xmax, ymax;   // pixels to scan, inside the viewport
+    int area;                     // E_0 + E_1 + E_2, twice the area, > 0
+    Edge e[3];                    // e[k] is the edge opposite vertex k
+};
+
+// Sets up the edge functions of triangle p for the viewport
+// [0, width) x [0, height). False if the triangle has no area or no
+// pixel of its bounding box is in the viewport.
+bool setup_triangle(const Point p[3], int width, int height, TriangleSetup& t);
+
+// t cut down to the pixels [x0, x1] x [y0, y1], e.g. one screen tile;
+// false if none of the triangle's box is left
+bool restrict_setup(const TriangleSetup& t, int x0, int y0, int x1, int y1, TriangleSetup& r);
+
+// Calls plot(x, y, color) for every pixel of the triangle.
+template <class Plot>
+void rasterize_flat(const TriangleSetup& t, const Color& color, Plot plot)
+{
+    int r0 = t.e[0].w, r1 = t.e[1].w, r2 = t.e[2].w;
+    for (int y = t.ymin; y <= t.ymax; y++) {
+        int w0 = r0, w1 = r1, w2 = r2;
+        for (int x = t.xmin; x <= t.xmax; x++) {
+            // all three >= 0 iff no sign bit is set
+            if ((w0 | w1 | w2) >= 0)
+                plot(x, y, color);
+            w0 += t.e[0].dx;
+            w1 += t.e[1].dx;
+            w2 += t.e[2].dx;
+        }
+        r0 += t.e[0].dy;
+        r1 += t.e[1].dy;
+        r2 += t.e[2].dy;
+    }
+}
+
+// Calls plot(x, y, color) for every pixel of the triangle, with the
+// vertex colors c interpolated by the barycentric weights.
+template <class Plot>
+void rasterize_gouraud(const TriangleSetup& t, const Color c[3], Plot plot)
+{
+    float inv = 1.0f / t.area;
+    int b0 = t.e[0].bias, b1 = t.e[1].bias, b2 = t.e[2].bias;
+    int r0 = t.e[0].w, r1 = t.e[1].w, r2 = t.e[2].w;
+    for (int y = t.ymin; y <= t.ymax; y++) {
+        int w0 = r0, w1 = r1, w2 = r2;
+        for (int x = t.xmin; x <= t.xmax; x++) {
+            if ((w0 | w1 | w2) >= 0) {
+                float l0 = (w0 + b0) * inv, l1 = (w1 + b1) * inv, l2 = (w2 + b2) * inv;
+                plot(x, y, Color(l0 * c[0].r + l1 * c[1].r + l2 * c[2].r,
+                                 l0 * c[0].g + l1 * c[1].g + l2 * c[2].g,
+                                 l0 * c[0].b + l1 * c[1].b + l2 * c[2].b));
+            }
+            w0 += t.e[0].dx;
+            w1 += t.e[1].dx;
+            w2 += t.e[2].dx;
+        }
+        r0 += t.e[0].dy;
+        r1 += t.e[1].dy;
+        r2 += t.e[2].dy;
+    }
+}
+
+#endif
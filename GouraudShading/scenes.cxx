@@ -0,0 +1,148 @@
+#include "scenes.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+// appends triangle (a, b, c) with random colors and depths
+struct SceneBuilder
+{
+    TriangleBatch& batch;
+    std::mt19937& rng;
+    std::uniform_real_distribution<float> unit;
+
+    SceneBuilder(TriangleBatch& batch, std::mt19937& rng) : batch(batch), rng(rng), unit(0, 1) {}
+
+    unsigned vertex(const Point& p)
+    {
+        batch.vertices.push_back(p);
+        batch.colors.push_back(Color(unit(rng), unit(rng), unit(rng)));
+        batch.depths.push_back(unit(rng));
+        return (unsigned) batch.vertices.size() - 1;
+    }
+
+    void triangle(unsigned a, unsigned b, unsigned c)
+    {
+        batch.indices.push_back(a);
+        batch.indices.push_back(b);
+        batch.indices.push_back(c);
+    }
+
+    void triangle(const Point& a, const Point& b, const Point& c)
+    {
+        unsigned i = vertex(a), j = vertex(b), k = vertex(c);
+        triangle(i, j, k);
+    }
+};
+
+void slivers(int n, int width, int height, SceneBuilder& s)
+{
+    std::uniform_int_distribution<int> x(0, width - 1), y(0, height - 1), length(-256, 256), thick(-2, 2);
+    for (int t = 0; t < n; t++) {
+        Point a(x(s.rng), y(s.rng));
+        Point b(std::min(std::max(a.x + length(s.rng), 0), width - 1),
+                std::min(std::max(a.y + length(s.rng), 0), height - 1));
+        Point c((a.x + b.x) / 2 + thick(s.rng), (a.y + b.y) / 2 + thick(s.rng));
+        s.triangle(a, b, c);
+    }
+}
+
+void screen(int n, int width, int height, SceneBuilder& s)
+{
+    // one vertex near each of three corners of the viewport
+    std::uniform_int_distribution<int> dx(0, width / 8), dy(0, height / 8), corner(0, 3);
+    for (int t = 0; t < n; t++) {
+        int skip = corner(s.rng);
+        Point p[3];
+        for (int k = 0, q = 0; q < 4; q++) {
+            if (q == skip) continue;
+            int x = q & 1 ? width - 1 - dx(s.rng) : dx(s.rng);
+            int y = q & 2 ? height - 1 - dy(s.rng) : dy(s.rng);
+            p[k++] = Point(x, y);
+        }
+        s.triangle(p[0], p[1], p[2]);
+    }
+}
+
+void huge(int n, int width, int height, SceneBuilder& s)
+{
+    // one vertex on the screen, two up to a million pixels away
+    std::uniform_int_distribution<int> x(0, width - 1), y(0, height - 1), far(-1000000, 1000000);
+    for (int t = 0; t < n; t++)
+        s.triangle(Point(x(s.rng), y(s.rng)), Point(far(s.rng), far(s.rng)), Point(far(s.rng), far(s.rng)));
+}
+
+// true if triangle (a, b, c) turns clockwise on screen (y down)
+bool clockwise(const TriangleBatch& batch, unsigned a, unsigned b, unsigned c)
+{
+    const Point &p = batch.vertices[a], &q = batch.vertices[b], &r = batch.vertices[c];
+    return (long long) (q.x - p.x) * (r.y - p.y) - (long long) (q.y - p.y) * (r.x - p.x) > 0;
+}
+
+void mesh(int cell, int width, int height, SceneBuilder& s)
+{
+    int nx = width / cell, ny = height / cell;
+    std::uniform_int_distribution<int> jitter(-cell / 3, cell / 3);
+    std::vector<unsigned> v((nx + 1) * (ny + 1));
+    for (int j = 0; j <= ny; j++) {
+        for (int i = 0; i <= nx; i++) {
+            // the border stays straight, so the mesh fills a rectangle
+            int x = i * cell + (i > 0 && i < nx ? jitter(s.rng) : 0);
+            int y = j * cell + (j > 0 && j < ny ? jitter(s.rng) : 0);
+            v[j * (nx + 1) + i] = s.vertex(Point(std::min(x, width - 1), std::min(y, height - 1)));
+        }
+    }
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            unsigned a = v[j * (nx + 1) + i], b = v[j * (nx + 1) + i + 1];
+            unsigned c = v[(j + 1) * (nx + 1) + i], d = v[(j + 1) * (nx + 1) + i + 1];
+            // alternate the diagonal, and the winding, from cell to cell;
+            // a cell the jitter made concave is split at its reflex corner
+            bool ad = (i + j) % 2 != 0;
+            if (ad && !(clockwise(s.batch, a, b, d) && clockwise(s.batch, d, c, a)))
+                ad = false;
+            else if (!ad && !(clockwise(s.batch, a, b, c) && clockwise(s.batch, b, d, c)))
+                ad = true;
+            if (ad) {
+                s.triangle(a, b, d);
+                s.triangle(d, c, a);
+            }
+            else {
+                s.triangle(a, c, b);
+                s.triangle(b, c, d);
+            }
+        }
+    }
+}
+
+}
+
+bool make_scene(const std::string& name, int width, int height, unsigned seed, TriangleBatch& batch)
+{
+    batch = TriangleBatch();
+    std::mt19937 rng(seed);
+    SceneBuilder s(batch, rng);
+
+    if (name == "tiny")
+        random_batch(500000, 3, width, height, seed, batch);
+    else if (name == "slivers")
+        slivers(100000, width, height, s);
+    else if (name == "screen")
+        screen(100, width, height, s);
+    else if (name == "random")
+        random_batch(100000, 64, width, height, seed, batch);
+    else if (name == "mesh")
+        mesh(16, width, height, s);
+    else if (name == "huge")
+        huge(100, width, height, s);
+    else
+        return false;
+    return true;
+}
+
+std::vector<std::string> scene_names()
+{
+    const char* names[] = { "tiny", "slivers", "screen", "random", "mesh", "huge" };
+    return std::vector<std::string>(names, names + 6);
+}
@@ -0,0 +1,28 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <string>
+#include <vector>
+#include "batch.h"
+
+// Reproducible triangle sets for benchmarks and coverage checks, inside a
+// width x height viewport, with random vertex colors and depths:
+//
+//   tiny     500,000 triangles of at most 3 px across
+//   slivers  100,000 triangles up to 256 px long and at most 2 px wide,
+//            in every direction
+//   screen   100 triangles spanning the whole viewport
+//   random   100,000 triangles of at most 64 px across
+//   mesh     a grid of 16 px cells over the viewport, two triangles per
+//            cell, with jittered vertices shared by the neighboring cells
+//   huge     100 triangles with one vertex in the viewport and two up to
+//            a million pixels away, far outside the guard band (clip.h)
+//
+// The same name, size and seed give the same triangles. False for an
+// unknown name.
+bool make_scene(const std::string& name, int width, int height, unsigned seed, TriangleBatch& batch);
+
+// the names above, in that order
+std::vector<std::string> scene_names();
+
+#endif
@@ -0,0 +1,314 @@
+#include "stream.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(Point) == 2 * sizeof(int32_t), "positions are mapped as Points");
+static_assert(sizeof(Color) == 3 * sizeof(float), "colors are mapped as Colors");
+
+namespace {
+
+uint64_t align_up(uint64_t v)
+{
+    return (v + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+}
+
+// section layout, returns the file size
+uint64_t layout(uint64_t vertices, uint64_t triangles, bool indexed, uint64_t offset[SEC_COUNT])
+{
+    uint64_t size[SEC_COUNT] = { vertices * sizeof(Point), vertices * sizeof(Color),
+                                 indexed ? 3 * triangles * sizeof(uint32_t) : 0 };
+    uint64_t at = align_up(sizeof(StreamHeader));
+    for (int s = 0; s < SEC_COUNT; s++) {
+        offset[s] = at;
+        at = align_up(at + size[s]);
+    }
+    return at;
+}
+
+const size_t PAGE = 4096;
+
+}
+
+bool StreamFile::open(const std::string& path, std::string& err)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(StreamHeader)) {
+        ::close(fd);
+        err = path + " is not a triangle stream (too short)";
+        return false;
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        err = "cannot map " + path;
+        return false;
+    }
+    base = (const uint8_t*) p;
+    length = st.st_size;
+
+    const StreamHeader& h = header();
+    uint64_t expect[SEC_COUNT];
+    if (memcmp(h.magic, STREAM_MAGIC, sizeof(h.magic)) != 0)
+        err = path + " is not a triangle stream (bad magic, text streams need stream_convert first)";
+    else if (h.version != STREAM_VERSION)
+        err = path + ": unsupported stream version " + std::to_string(h.version);
+    else if (h.byte_order != STREAM_BYTE_ORDER)
+        err = path + " was written on a machine with a different byte order";
+    else if (h.triangles > (uint64_t) INT32_MAX || h.vertices > UINT32_MAX ||
+             (!h.indexed && h.vertices != 3 * h.triangles))
+        err = path + " has a broken triangle or vertex count";
+    else if (layout(h.vertices, h.triangles, h.indexed != 0, expect) > length ||
+             memcmp(expect, h.offset, sizeof(expect)) != 0)
+        err = path + " is truncated or has a broken section table";
+    else {
+        const uint32_t* indices = h.indexed ? (const uint32_t*) (base + h.offset[SEC_INDICES]) : nullptr;
+        for (uint64_t k = 0; indices && k < 3 * h.triangles; k++) {
+            if (indices[k] >= h.vertices) {
+                err = path + " has a vertex index out of range";
+                close();
+                return false;
+            }
+        }
+        // the triangles are drawn front to back
+        madvise((void*) base, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    close();
+    return false;
+}
+
+void StreamFile::close()
+{
+    if (base) munmap((void*) base, length);
+    base = nullptr;
+    length = 0;
+}
+
+TriangleView StreamFile::view() const
+{
+    const StreamHeader& h = header();
+    return TriangleView((const Point*) (base + h.offset[SEC_POSITIONS]),
+                        (const Color*) (base + h.offset[SEC_COLORS]), nullptr,
+                        h.indexed ? (const unsigned*) (base + h.offset[SEC_INDICES]) : nullptr,
+                        (int) h.triangles);
+}
+
+template <class F>
+void StreamFile::ranges(int begin, int end, F f) const
+{
+    const StreamHeader& h = header();
+    if (h.indexed) {
+        f(base + h.offset[SEC_INDICES] + 3 * (size_t) begin * sizeof(uint32_t),
+          3 * (size_t) (end - begin) * sizeof(uint32_t));
+        return;
+    }
+    f(base + h.offset[SEC_POSITIONS] + 3 * (size_t) begin * sizeof(Point), 3 * (size_t) (end - begin) * sizeof(Point));
+    f(base + h.offset[SEC_COLORS] + 3 * (size_t) begin * sizeof(Color), 3 * (size_t) (end - begin) * sizeof(Color));
+}
+
+void StreamFile::prefetch(int begin, int end) const
+{
+    ranges(begin, end, [](const uint8_t* p, size_t n) {
+        // one read per page faults it in
+        volatile uint8_t sink = 0;
+        for (size_t k = 0; k < n; k += PAGE)
+            sink += p[k];
+        (void) sink;
+    });
+}
+
+void StreamFile::release(int begin, int end) const
+{
+    ranges(begin, end, [](const uint8_t* p, size_t n) {
+        // only whole pages: the first and last may be shared with the
+        // chunks before and after
+        uintptr_t a = ((uintptr_t) p + PAGE - 1) / PAGE * PAGE, b = ((uintptr_t) p + n) / PAGE * PAGE;
+        if (a < b) madvise((void*) a, b - a, MADV_DONTNEED);
+    });
+}
+
+bool write_stream_file(const std::string& path, const TriangleBatch& batch, bool indexed, std::string& err)
+{
+    StreamHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, STREAM_MAGIC, sizeof(h.magic));
+    h.version = STREAM_VERSION;
+    h.byte_order = STREAM_BYTE_ORDER;
+    h.triangles = batch.triangles();
+    h.vertices = indexed ? batch.vertices.size() : 3 * h.triangles;
+    h.indexed = indexed;
+    uint64_t size = layout(h.vertices, h.triangles, indexed, h.offset);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        err = "cannot create " + path;
+        return false;
+    }
+
+    // writes one section, padded up to the next one
+    uint64_t at = 0;
+    auto put = [&](const void* data, uint64_t bytes, uint64_t next) {
+        out.write((const char*) data, bytes);
+        static const char zeros[STREAM_ALIGN] = {0};
+        out.write(zeros, next - at - bytes);
+        at = next;
+    };
+    put(&h, sizeof(h), h.offset[SEC_POSITIONS]);
+
+    if (indexed) {
+        put(batch.vertices.data(), h.vertices * sizeof(Point), h.offset[SEC_COLORS]);
+        put(batch.colors.data(), h.vertices * sizeof(Color), h.offset[SEC_INDICES]);
+        put(batch.indices.data(), batch.indices.size() * sizeof(uint32_t), size);
+    }
+    else {
+        std::vector<Point> vertices(h.vertices);
+        std::vector<Color> colors(h.vertices);
+        for (size_t k = 0; k < batch.indices.size(); k++) {
+            vertices[k] = batch.vertices[batch.indices[k]];
+            colors[k] = batch.colors[batch.indices[k]];
+        }
+        put(vertices.data(), vertices.size() * sizeof(Point), h.offset[SEC_COLORS]);
+        put(colors.data(), colors.size() * sizeof(Color), h.offset[SEC_INDICES]);
+        put(nullptr, 0, size);
+    }
+
+    if (!out) {
+        err = "error writing " + path;
+        return false;
+    }
+    return true;
+}
+
+bool read_stream_text(std::istream& in, TriangleBatch& batch, bool& indexed, std::string& err)
+{
+    batch = TriangleBatch();
+    indexed = false;
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream ls(line);
+        std::string what;
+        if (!(ls >> what)) continue;
+
+        bool ok;
+        if (what == "v") {
+            Point p;
+            Color c(1, 1, 1);
+            ok = (bool) (ls >> p.x >> p.y);
+            if (ok && !(ls >> std::ws).eof())
+                ok = (bool) (ls >> c.r >> c.g >> c.b);
+            if (ok) {
+                batch.vertices.push_back(p);
+                batch.colors.push_back(c);
+            }
+        }
+        else if (what == "f") {
+            long v[3];
+            ok = (bool) (ls >> v[0] >> v[1] >> v[2]);
+            for (int k = 0; ok && k < 3; k++) {
+                ok = v[k] >= 1 && v[k] <= (long) batch.vertices.size();
+                if (ok) batch.indices.push_back((unsigned) (v[k] - 1));
+            }
+            indexed = true;
+        }
+        else {
+            ok = false;
+        }
+
+        std::string extra;
+        if (!ok || ls >> extra) {
+            err = "line " + std::to_string(lineno) + ": cannot parse '" + line + "'";
+            return false;
+        }
+    }
+
+    if (!indexed) {
+        if (batch.vertices.size() % 3) {
+            err = "the number of vertices is not a multiple of 3";
+            return false;
+        }
+        for (size_t k = 0; k < batch.vertices.size(); k++)
+            batch.indices.push_back((unsigned) k);
+    }
+    batch.depths.assign(batch.vertices.size(), 0.0f);
+    return true;
+}
+
+BatchStats draw_stream(const StreamFile& stream, Framebuffer& fb, WorkerPool& pool, int tile, int chunk)
+{
+    BatchStats stats;
+    TriangleView all = stream.view();
+    int n = all.count;
+
+    // one prefetch thread for the whole stream, which faults in the
+    // triangles up to asked and reports them in ready
+    std::mutex lock;
+    std::condition_variable more, fetched;
+    int asked = 0, ready = 0;
+    bool quit = false;
+    std::thread prefetcher([&]() {
+        std::unique_lock<std::mutex> g(lock);
+        for (;;) {
+            more.wait(g, [&] { return quit || asked > ready; });
+            if (quit) return;
+            int begin = ready, end = asked;
+            g.unlock();
+            stream.prefetch(begin, end);
+            g.lock();
+            ready = end;
+            fetched.notify_one();
+        }
+    });
+    auto ask = [&](int end) {
+        std::lock_guard<std::mutex> g(lock);
+        asked = end;
+        more.notify_one();
+    };
+    auto wait_ready = [&](int end) {
+        std::unique_lock<std::mutex> g(lock);
+        fetched.wait(g, [&] { return ready >= end; });
+    };
+
+    for (int begin = 0; begin < n; begin += chunk) {
+        int end = begin + std::min(chunk, n - begin);
+        int next_end = end + std::min(chunk, n - end);
+        // the first chunk has nobody to overlap with
+        if (begin == 0) {
+            ask(end);
+            wait_ready(end);
+        }
+        ask(next_end);
+        stats.add(rasterize_batch(all.slice(begin, end), fb, pool, tile));
+        wait_ready(next_end);
+        stream.release(begin, end);
+    }
+
+    {
+        std::lock_guard<std::mutex> g(lock);
+        quit = true;
+    }
+    more.notify_one();
+    prefetcher.join();
+    return stats;
+}
@@ -0,0 +1,100 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include "batch.h"
+
+// Binary triangle stream file (.tri)
+//
+//   header    StreamHeader, at offset 0
+//   sections  each starting on a STREAM_ALIGN byte boundary:
+//     positions  int32 x, y per vertex (a Point)
+//     colors     float r, g, b per vertex (a Color)
+//     indices    uint32, three per triangle; empty if the triangles are
+//                stored as consecutive vertex triples
+//
+// The sections have the memory layout of the rasterizer's own arrays, so
+// a mapped stream is drawn in place, without copying or converting.
+// Everything is stored in the byte order of the machine that wrote it;
+// byte_order tells the reader whether that matches its own.
+
+const char STREAM_MAGIC[8] = "GSTREAM";
+const uint32_t STREAM_VERSION = 1;
+const uint32_t STREAM_BYTE_ORDER = 0x01020304;
+const uint64_t STREAM_ALIGN = 64;
+
+enum StreamSection { SEC_POSITIONS, SEC_COLORS, SEC_INDICES, SEC_COUNT };
+
+struct StreamHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t vertices;
+    uint64_t triangles;
+    uint64_t indexed;               // 1 if the indices section is used
+    uint64_t offset[SEC_COUNT];     // file offset of each section
+};
+
+// A triangle stream mapped into memory. Opening it reads nothing but the
+// header (and, for an indexed stream, the indices, to check they are in
+// range); pages are faulted in as the triangles are drawn.
+class StreamFile
+{
+public:
+    StreamFile() : base(nullptr), length(0) {}
+    ~StreamFile() { close(); }
+
+    // maps path and checks the header and section bounds,
+    // on failure returns false with the reason in err
+    bool open(const std::string& path, std::string& err);
+    void close();
+
+    const StreamHeader& header() const { return *(const StreamHeader*) base; }
+    int triangles() const { return (int) header().triangles; }
+    size_t bytes() const { return length; }
+
+    // all triangles, pointing into the mapping (no depths)
+    TriangleView view() const;
+
+    // Faults in the pages that hold triangles [begin, end) (prefetch), or
+    // drops them from this process (release): the file stays in the page
+    // cache, but no longer counts towards its memory. For an indexed
+    // stream only the indices are covered; the vertices stay mapped.
+    void prefetch(int begin, int end) const;
+    void release(int begin, int end) const;
+
+private:
+    StreamFile(const StreamFile&);
+    StreamFile& operator=(const StreamFile&);
+
+    // calls f(first byte, bytes) for the parts of the sections that hold
+    // triangles [begin, end); all vertices for an indexed stream
+    template <class F> void ranges(int begin, int end, F f) const;
+
+    const uint8_t* base;
+    size_t length;
+};
+
+// writes batch as a stream file; unless indexed, the triangles are
+// written as vertex triples
+bool write_stream_file(const std::string& path, const TriangleBatch& batch, bool indexed, std::string& err);
+
+// Reads the text form of a triangle stream, one item per line, # starts a
+// comment:
+//   v x y [r g b]    vertex, with an optional color (default white)
+//   f a b c          triangle of vertices a, b and c, counted from 1
+// Without any f line the vertices are taken three at a time, and indexed
+// is set to false.
+bool read_stream_text(std::istream& in, TriangleBatch& batch, bool& indexed, std::string& err);
+
+// Draws stream with rasterize_batch() on the threads of pool, chunk
+// triangles at a time, straight from the mapping. While one chunk is
+// drawn, a thread of its own faults in the pages of the next, so reading
+// the file overlaps drawing; pages of finished chunks are released, so
+// memory use does not grow with the stream.
+BatchStats draw_stream(const StreamFile& stream, Framebuffer& fb, WorkerPool& pool, int tile, int chunk);
+
+#endif
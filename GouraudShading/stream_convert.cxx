@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "batch.h"
+#include "stream.h"
+
+using namespace std;
+
+// converts a text triangle stream (see stream.h) into the binary format
+// template maps with --stream, or writes n random triangles, the same as
+// template --triangles n with the same size, viewport and seed
+int main(int argc, char* argv[])
+{
+    TriangleBatch batch;
+    bool indexed = false;
+    string err;
+
+    if (argc >= 4 && string(argv[1]) == "--random" && argc % 2 == 0) {
+        int n = atoi(argv[2]), size = 32, width = 512, height = 512;
+        unsigned seed = 1;
+        bool ok = n > 0;
+        for (int a = 3; ok && a + 1 < argc; a += 2) {
+            string arg = argv[a];
+            if (arg == "--triangle-size")
+                ok = (size = atoi(argv[a + 1])) > 0;
+            else if (arg == "--size")
+                ok = sscanf(argv[a + 1], "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+            else if (arg == "--seed")
+                seed = (unsigned) atoi(argv[a + 1]);
+            else
+                ok = false;
+        }
+        if (!ok) argc = 0;
+        else random_batch(n, size, width, height, seed, batch);
+    }
+    else if (argc == 3) {
+        ifstream in(argv[1]);
+        if (!in) {
+            cerr << "stream_convert: cannot open input file " << argv[1] << endl;
+            exit(1);
+        }
+        if (!read_stream_text(in, batch, indexed, err)) {
+            cerr << "stream_convert: " << argv[1] << ": " << err << endl;
+            exit(1);
+        }
+    }
+    else {
+        argc = 0;
+    }
+    if (argc == 0) {
+        cerr << "Usage:  stream_convert triangles.txt triangles.tri\n"
+             << "        stream_convert --random N [--triangle-size S] [--size WxH] [--seed N] triangles.tri\n";
+        exit(1);
+    }
+
+    string out = argv[argc - 1];
+    if (!write_stream_file(out, batch, indexed, err)) {
+        cerr << "stream_convert: " << err << endl;
+        exit(1);
+    }
+    cerr << "stream_convert: wrote " << batch.triangles() << " triangles (" << (indexed ? "indexed" : "vertex triples")
+         << ") to " << out << endl;
+
+    return 0;
+}
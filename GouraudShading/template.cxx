@@ -1,47 +1,48 @@
+#ifndef GOURAUD_HEADLESS
 #include <GL/glut.h>
+#endif
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <sys/resource.h>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "raster.h"
+#include "clip.h"
+#include "framebuffer.h"
+#include "batch.h"
+#include "stream.h"
+#include "fill.h"
+#include "interpolate.h"
+#include "parallel.h"
 
 using std::cin;
 using std::cerr;
 using std::endl;
+using std::string;
+using std::vector;
 
+#ifndef GOURAUD_HEADLESS
 // callbacks for glut (see main() for what they do)
 void reshape(int w, int h);
 void display();
 void mouse(int button, int state, int x, int y);
 void keyboard(unsigned char key, int x, int y); 
-
-// Simple structure for a point
-struct Point
-{
-    int x;
-    int y;
-    Point() : x(-1), y(-1) {}
-    Point(int x, int y) : x(x), y(y) {}
-};
-
-struct Color
-{
-    float r;
-    float g;
-    float b;
-
-    Color() : r(0), g(0), b(0) {}
-    Color(float r, float g, float b) : r(r), g(g), b(b) {}
-};
-
-// helpers
 void init();
 void addPoint(int x, int y);
 void keyboard_input();
-void draw_point(int x, int y, Color c);
-void draw_line(int x0, int y0, int x1, int y1, Color c);
+#endif
+
+// helpers
 void draw_triangle();
 void triangle_wireframe(Color color);
+void fill_textured(const ClippedTriangle& t);
 
 // Keeps track of current shading mode
-enum ShadingMode { WIREFRAME, FLAT, GOURAUD };
+enum ShadingMode { WIREFRAME, FLAT, GOURAUD, TEXTURED };
 ShadingMode shading_mode = WIREFRAME;
 
 // Initial window size
@@ -51,13 +52,249 @@ int win_h = 512;
 // For triangles, 3 points will do
 Point points[3];
 
+// clip-space w of the points, for perspective-correct TEXTURED shading
+float point_w[3] = { 1, 1, 1 };
+
 // Used to keep track of how many points I have so far
 int num_points;
 
+// Everything is drawn here first, then shown with one glDrawPixels() per
+// frame or, with --ppm, written to a file
+Framebuffer framebuffer;
+
+// --triangles: a batch of random Gouraud triangles instead of the one on
+// stdin, drawn by rasterize_batch()
+struct BatchOptions
+{
+    int triangles = 0;
+    int size = 32;       // at most this many pixels across
+    int threads = 1;     // 0: all hardware threads
+    int tile = 64;
+    unsigned seed = 1;
+    bool depth = false;  // depth test against a z-buffer
+    bool hiz = true;     // with 8x8 tile bounds (see depth.h)
+    string order = "random";   // or front (to back) or back (to front)
+    string stream;       // --stream: a triangle stream file instead
+    int chunk = 1 << 16; // triangles of the stream drawn at a time
+};
+BatchOptions batch_options;
+
+void usage()
+{
+    cerr << "usage: template [--ppm out.ppm [options]] [GLUT options]\n"
+         << "  --ppm F   read the three points from stdin, draw the triangle without\n"
+         << "            opening a window and write the image to F\n"
+         << "  --mode M  shading mode for --ppm: wireframe, flat, gouraud (default) or\n"
+         << "            textured (a checkerboard, see --w)\n"
+         << "  --w A,B,C clip-space w of the three points (default 1,1,1); textured\n"
+         << "            shading is perspective-correct for these\n"
+         << "  --size S  image size for --ppm (default 512x512)\n"
+         << "  --triangles N\n"
+         << "            draw N random Gouraud triangles with the tiled batch rasterizer\n"
+         << "  --triangle-size S\n"
+         << "            at most S pixels across (default 32)\n"
+         << "  --threads N  batch threads (0 = all hardware threads, default 1)\n"
+         << "  --tile N  batch tile size in pixels (default 64)\n"
+         << "  --seed N  random seed for --triangles (default 1)\n"
+         << "  --depth   depth test the random triangles (each has a random depth)\n"
+         << "  --no-hiz  with --depth, a plain z-buffer without the tile depth bounds\n"
+         << "  --order O draw the random triangles in random (default), front (to back)\n"
+         << "            or back (to front) order\n"
+         << "  --stream F  draw the binary triangle stream F (see stream_convert) instead,\n"
+         << "            mapped and drawn in chunks by the batch rasterizer\n"
+         << "  --chunk N triangles of the stream per chunk (default 65536)\n"
+         << "  --kernel K  fill kernels: auto, avx2 or scalar (default auto)\n"
+         << "without --ppm, options of GLUT such as -display and -geometry are passed on" << endl;
+    exit(1);
+}
+
+// --triangles: draws the random batch into the framebuffer
+void draw_batch()
+{
+    const BatchOptions& o = batch_options;
+    TriangleBatch batch;
+    random_batch(o.triangles, o.size, win_w, win_h, o.seed, batch);
+    if (o.order != "random") sort_by_depth(batch, o.order == "front");
+
+    int nthreads = o.threads > 0 ? o.threads : hardware_threads();
+    framebuffer.clear(Color(0.0, 0.0, 0.0));
+    DepthBuffer depth;
+    if (o.depth) {
+        depth.resize(win_w, win_h);
+        depth.clear();
+        depth.hierarchical = o.hiz;
+    }
+    WorkerPool pool(nthreads);
+    BatchStats st = rasterize_batch(batch, framebuffer, pool, o.tile, o.depth ? &depth : nullptr);
+    double ms = st.setup_ms + st.raster_ms;
+    cerr << "batch: " << o.triangles << " triangles (" << st.drawn << " drawn) of up to " << o.size
+         << " px on " << nthreads << " thread(s), " << o.tile << " px tiles: setup " << st.setup_ms
+         << " ms, tiles " << st.raster_ms << " ms, " << o.triangles / ms / 1e3 << " Mtriangles/s, "
+         << st.area / ms / 1e3 << " Mpixels/s, "
+         << (double) st.bin_entries / std::max(st.drawn, 1) << " tiles per triangle" << endl;
+    if (o.depth) {
+        const DepthStats& d = st.depth;
+        cerr << "depth: " << (o.hiz ? "hierarchical" : "plain") << " z-buffer, " << o.order
+             << " order, depth complexity " << st.area / ((double) win_w * win_h) << ": " << d.culled
+             << " triangle parts culled whole, " << d.tiles_culled << " 8x8 tiles culled, " << d.tiles_accepted
+             << " accepted, " << d.tested << " pixels depth tested, " << d.shaded << " shaded" << endl;
+    }
+}
+
+// --stream: draws the mapped stream into the framebuffer
+int draw_stream_file()
+{
+    const BatchOptions& o = batch_options;
+    StreamFile stream;
+    string err;
+    if (!stream.open(o.stream, err)) {
+        cerr << err << endl;
+        return 1;
+    }
+
+    int nthreads = o.threads > 0 ? o.threads : hardware_threads();
+    framebuffer.clear(Color(0.0, 0.0, 0.0));
+    WorkerPool pool(nthreads);
+    auto start = std::chrono::steady_clock::now();
+    BatchStats st = draw_stream(stream, framebuffer, pool, o.tile, o.chunk);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    cerr << "stream: " << stream.triangles() << " triangles (" << st.drawn << " drawn), "
+         << stream.bytes() / 1e6 << " MB, " << (stream.triangles() + o.chunk - 1) / o.chunk << " chunk(s) on "
+         << nthreads << " thread(s): " << ms << " ms (setup " << st.setup_ms << " ms, tiles " << st.raster_ms
+         << " ms), " << stream.triangles() / ms / 1e3 << " Mtriangles/s, " << stream.bytes() / ms / 1e3
+         << " MB/s, peak RSS " << ru.ru_maxrss / 1024.0 << " MB" << endl;
+    return 0;
+}
+
+// --ppm: draws the triangle given on stdin into the framebuffer and writes
+// it out; needs no display or GL
+int draw_to_ppm(const char* path)
+{
+    for (int i = 0; i < 3 && batch_options.triangles == 0 && batch_options.stream.empty(); i++) {
+        if (!(cin >> points[i].x >> points[i].y)) {
+            cerr << "expected three points \"x y\" on stdin" << endl;
+            return 1;
+        }
+    }
+    framebuffer.resize(win_w, win_h);
+
+    if (!batch_options.stream.empty()) {
+        if (draw_stream_file() != 0) return 1;
+    }
+    else if (batch_options.triangles > 0)
+        draw_batch();
+    else {
+        clock_t start = clock();
+        draw_triangle();
+        double ms = 1e3 * (clock() - start) / CLOCKS_PER_SEC;
+        cerr << "raster: " << win_w << "x" << win_h << " in " << ms << " ms" << endl;
+    }
+
+    if (!write_ppm(path, framebuffer)) {
+        cerr << "cannot write " << path << endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
-    // initialize glut
-    glutInit(&argc, argv);
+    const char* ppm = 0;
+    ShadingMode ppm_mode = GOURAUD;
+    string kernel = "auto";
+    // what is not ours is left for glutInit (-display, -geometry, ...)
+    vector<char*> glut_args(1, argv[0]);
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--ppm" && a + 1 < argc)
+            ppm = argv[++a];
+        else if (arg == "--mode" && a + 1 < argc) {
+            string m = argv[++a];
+            if (m == "wireframe") ppm_mode = WIREFRAME;
+            else if (m == "flat") ppm_mode = FLAT;
+            else if (m == "gouraud") ppm_mode = GOURAUD;
+            else if (m == "textured") ppm_mode = TEXTURED;
+            else usage();
+        }
+        else if (arg == "--w" && a + 1 < argc) {
+            if (sscanf(argv[++a], "%f,%f,%f", &point_w[0], &point_w[1], &point_w[2]) != 3 ||
+                !(point_w[0] > 0 && point_w[1] > 0 && point_w[2] > 0))
+                usage();
+        }
+        else if (arg == "--size" && a + 1 < argc) {
+            if (sscanf(argv[++a], "%dx%d", &win_w, &win_h) != 2 || win_w < 1 || win_h < 1)
+                usage();
+            if (win_w > GUARD_BAND || win_h > GUARD_BAND) {
+                cerr << "--size: at most " << GUARD_BAND << " pixels each way (the guard band, clip.h)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--triangles" && a + 1 < argc)
+            batch_options.triangles = atoi(argv[++a]);
+        else if (arg == "--triangle-size" && a + 1 < argc)
+            batch_options.size = atoi(argv[++a]);
+        else if (arg == "--threads" && a + 1 < argc)
+            batch_options.threads = atoi(argv[++a]);
+        else if (arg == "--tile" && a + 1 < argc)
+            batch_options.tile = atoi(argv[++a]);
+        else if (arg == "--seed" && a + 1 < argc)
+            batch_options.seed = (unsigned) atoi(argv[++a]);
+        else if (arg == "--depth")
+            batch_options.depth = true;
+        else if (arg == "--no-hiz")
+            batch_options.hiz = false;
+        else if (arg == "--order" && a + 1 < argc) {
+            batch_options.order = argv[++a];
+            if (batch_options.order != "random" && batch_options.order != "front" &&
+                batch_options.order != "back")
+                usage();
+        }
+        else if (arg == "--stream" && a + 1 < argc)
+            batch_options.stream = argv[++a];
+        else if (arg == "--chunk" && a + 1 < argc)
+            batch_options.chunk = atoi(argv[++a]);
+        else if (arg == "--kernel" && a + 1 < argc)
+            kernel = argv[++a];
+        else if (arg.compare(0, 2, "--") == 0)
+            usage();
+        else
+            glut_args.push_back(argv[a]);
+    }
+    if (batch_options.triangles < 0 || batch_options.size < 1 || batch_options.threads < 0 ||
+        batch_options.tile < 1 || batch_options.chunk < 1)
+        usage();
+    if (!batch_options.stream.empty() && !ppm) {
+        cerr << "--stream needs --ppm" << endl;
+        return 1;
+    }
+    if (!batch_options.stream.empty() && (batch_options.triangles > 0 || batch_options.depth)) {
+        cerr << "--stream has no depths and cannot be combined with --triangles or --depth" << endl;
+        return 1;
+    }
+    string selected = select_fill(kernel);
+    if (selected.empty()) {
+        cerr << "fill kernels \"" << kernel << "\" unknown or not supported by this CPU" << endl;
+        return 1;
+    }
+    if (ppm) {
+        // no window, so no GLUT to take them
+        if (glut_args.size() > 1) usage();
+        cerr << "fill kernels: " << selected << endl;
+        shading_mode = ppm_mode;
+        return draw_to_ppm(ppm);
+    }
+
+#ifdef GOURAUD_HEADLESS
+    cerr << "built without GLUT (make template_headless), only --ppm is supported" << endl;
+    usage();
+#else
+    // initialize glut; it removes the options it knows from glut_args
+    int glut_argc = (int) glut_args.size();
+    glut_args.push_back(nullptr);
+    glutInit(&glut_argc, &glut_args[0]);
+    if (glut_argc > 1) usage();
 
     // use double buffering with RGB colors
     // double buffer removes most of the flickering
@@ -82,15 +319,21 @@ int main(int argc, char* argv[])
 
     // start event processing, i.e., accept user inputs
     glutMainLoop();
+#endif
 
     return 0;
 }
 
+#ifndef GOURAUD_HEADLESS
+
 // called when the window is resized/moved (plus some other cases)
 void reshape(int w, int h)
 {
-    win_w = w;
-    win_h = h;
+    // clip_triangle() cannot draw past the guard band
+    if (w > GUARD_BAND || h > GUARD_BAND)
+        cerr << "window larger than " << GUARD_BAND << " pixels, only that much of it is drawn" << endl;
+    win_w = std::min(w, GUARD_BAND);
+    win_h = std::min(h, GUARD_BAND);
     
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -103,11 +346,13 @@ void reshape(int w, int h)
 // called when the window needs to be redrawn
 void display()
 {    
-    // clear back buffer with background color that is set in init()
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    // now, draw on back buffer just cleared
+    // draw into the framebuffer, then copy it to the back buffer in one
+    // call; row 0 of the framebuffer is the top row of the window
+    framebuffer.resize(win_w, win_h);
     draw_triangle();
+    glRasterPos2i(0, win_h-1);
+    glPixelZoom(1.0, -1.0);
+    glDrawPixels(win_w, win_h, GL_RGBA, GL_UNSIGNED_BYTE, &framebuffer.pixels[0]);
     glutSwapBuffers();
 }
 
@@ -142,6 +387,9 @@ void keyboard(unsigned char key, int x, int y)
     case 'g':  // gouraud shading
 	shading_mode = GOURAUD;
 	break;
+    case 't':  // textured (checkerboard)
+	shading_mode = TEXTURED;
+	break;
     case 'k':
 	keyboard_input();
 	num_points = 0;
@@ -189,33 +437,17 @@ void keyboard_input()
 	addPoint(x, y);
     }
 }
- 
-void draw_point(int x, int y, Color c)
-{
-    glBegin(GL_POINTS);
-    {
-	glColor3f(c.r, c.g, c.b);
-	glVertex2d(x, win_h-y);
-    }
-    glEnd();
-}
-
-void draw_line(int x0, int y0, int x1, int y1, Color c)
-{
-    glBegin(GL_LINES);
-    glColor3f(c.r, c.g, c.b);
-    glVertex2d(x0, win_h - y0);
-    glVertex2d(x1, win_h - y1);
-    glEnd();
-}
- 
-float area(int x1, int y1, int x2, int y2, int x3, int y3)
-{
-   return abs((x1*(y2-y3) + x2*(y3-y1)+ x3*(y1-y2))/2.0);
-}
+#endif
 
 void draw_triangle()
 {
+    // the triangle cut to the guard band, if it needs to be
+    ClippedTriangle t[MAX_CLIPPED];
+    int n;
+
+    // background color is black
+    framebuffer.clear(Color(0.0, 0.0, 0.0));
+
     switch (shading_mode) {
     case WIREFRAME:
     {
@@ -230,128 +462,55 @@ void draw_triangle()
     {
 	// choose the color for flat shading
 	Color color(0.5, 1.0, 0.5);
-	// HERE, draw a triangle with flat shading
-	//       using draw_point()
-	
 	triangle_wireframe(color);
-	
-	int x0 = points[0].x;
-        int y0 = points[0].y;
-	int x1 = points[1].x;
-	int y1 = points[1].y;
-	int x2 = points[2].x;
-        int y2 = points[2].y;
-
-	int xmin, xmax, ymin, ymax;
-	
-	if (x0 > x1 && x0 > x2) xmax = x0;
-	else if (x1 > x0 && x1 > x2) xmax = x1;
-	else if (x2 > x1 && x2 > x0) xmax = x2;
-
-	if (x0 < x1 && x0 < x2) xmin = x0;
-	else if (x1 < x0 && x1 < x2) xmin = x1;
-	else if (x2 < x1 && x2 < x0) xmin = x2;
-
-	if (y0 > y1 && y0 > y2) ymax = y0;
-        else if (y1 > y0 && y1 > y2) ymax = y1;
-        else if (y2 > y1 && y2 > y0) ymax = y2;
-
-        if (y0 < y1 && y0 < y2) ymin = y0;
-        else if (y1 < y0 && y1 < y2) ymin = y1;
-        else if (y2 < y1 && y2 < y0) ymin = y2;
-
-	if (xmin < 0) xmin = xmin * -1;
-	if (xmax < 0) xmax = xmax * -1;
-	if (ymin < 0) ymin = ymin * -1;
-	if (ymax < 0) ymax = ymax * -1;
-	
-    	for (int j = ymin; j < ymax; j++) { 
-        	for (int i = xmin; i < xmax; i++) { 
-			//float alpha = ((y1 - y2)*(i - x2)+(x2-x1)*(j - y2))/((y1 - y2)*(x0 - x2) + (x2 - x1)*(y0 - y2));
-                        //float beta = ((y2 - y0)*(i - x2)+(x0-x2)*(j - y2))/((y1 - y2)*(x0 - x2) + (x2 - x1)*(y0 - y2));
-                        //float gamma = 1.0f - alpha - beta;
-			
-   			float A = area (x0, y0, x1, y1, x2, y2);
-   			float A0 = area (i, j, x1, y1, x2, y2);
-   			float A1 = area (x0, y0, i, j, x2, y2);
-   			float A2 = area (x0, y0, x1, y1, i, j);
-
-			if (A0 + A1 + A2 == A) {
-				draw_point(i, j, color);
-            		} 
-        	} 
-    	}
+	n = clip_triangle(points, win_w, win_h, t);
+	for (int i = 0; i < n; i++)
+	    fill_flat(t[i].setup, color, framebuffer);
 	break;
     }
     case GOURAUD:
     {
 	// choose the vertex colors for gouraud shading
-	Color c0(1.0, 0.0, 0.0);
-	Color c1(0.0, 1.0, 0.0);
-	Color c2(0.0, 0.0, 1.0);
-	// HERE, draw a triangle with gouraud shading
-	//       using draw_point()
-	
-	Color color(0.0, 0.0, 0.0);
-	triangle_wireframe(color);
-
-        int x0 = points[0].x;
-        int y0 = points[0].y;
-        int x1 = points[1].x;
-        int y1 = points[1].y;
-        int x2 = points[2].x;
-        int y2 = points[2].y;
-
-	int xmin, xmax, ymin, ymax;
-
-        if (x0 > x1 && x0 > x2) xmax = x0;
-        else if (x1 > x0 && x1 > x2) xmax = x1;
-        else if (x2 > x1 && x2 > x0) xmax = x2;
-
-        if (x0 < x1 && x0 < x2) xmin = x0;
-        else if (x1 < x0 && x1 < x2) xmin = x1;
-        else if (x2 < x1 && x2 < x0) xmin = x2;
-
-        if (y0 > y1 && y0 > y2) ymax = y0;
-        else if (y1 > y0 && y1 > y2) ymax = y1;
-        else if (y2 > y1 && y2 > y0) ymax = y2;
-
-        if (y0 < y1 && y0 < y2) ymin = y0;
-        else if (y1 < y0 && y1 < y2) ymin = y1;
-        else if (y2 < y1 && y2 < y0) ymin = y2;
-
-        if (xmin < 0) xmin = xmin * -1;
-        if (xmax < 0) xmax = xmax * -1;
-        if (ymin < 0) ymin = ymin * -1;
-        if (ymax < 0) ymax = ymax * -1;
-
-	for (int j = ymin; j < ymax; j++) {
-                for (int i = xmin; i < xmax; i++) {
-                        //float alpha = ((y1 - y2)*(i - x2)+(x2-x1)*(j - y2))/((y1 - y2)*(x0 - x2) + (x2 - x1)*(y0 - y2));
-                        //float beta = ((y2 - y0)*(i - x2)+(x0-x2)*(j - y2))/((y1 - y2)*(x0 - x2) + (x2 - x1)*(y0 - y2));
-                        //float gamma = 1.0f - alpha - beta;
-
-                        float A = area (x0, y0, x1, y1, x2, y2);
-                        float A0 = area (i, j, x1, y1, x2, y2);
-                        float A1 = area (x0, y0, i, j, x2, y2);
-                        float A2 = area (x0, y0, x1, y1, i, j);
-                        if (A0 + A1 + A2 == A) {
-				A0 /= A;
-                		A1 /= A;
-                		A2 /= A; 
-				float r = (A0 * 1) + (A1 * 0) + (A2 * 0);
-                                float g = (A0 * 0) + (A1 * 1) + (A2 * 0);
-                                float b = (A0 * 0) + (A1 * 0) + (A2 * 1);
-                                Color color(r, g, b);
-                                draw_point(i, j, color);
-                        }
-                }
-        }
+	Color c[3] = { Color(1.0, 0.0, 0.0), Color(0.0, 1.0, 0.0), Color(0.0, 0.0, 1.0) };
+	triangle_wireframe(Color(0.0, 0.0, 0.0));
+	n = clip_triangle(points, win_w, win_h, t);
+	for (int i = 0; i < n; i++) {
+	    Color ci[3] = { clipped_color(t[i], 0, c), clipped_color(t[i], 1, c), clipped_color(t[i], 2, c) };
+	    fill_gouraud(t[i].setup, ci, framebuffer);
+	}
 	break;
     }
+    case TEXTURED:
+	triangle_wireframe(Color(0.0, 0.0, 0.0));
+	n = clip_triangle(points, win_w, win_h, t);
+	for (int i = 0; i < n; i++)
+	    fill_textured(t[i]);
+	break;
     }
 }
 
+// the Gouraud colors times an 8x8 checkerboard over the texture
+// coordinates (0, 0), (1, 0) and (0, 1) of the three points
+void fill_textured(const ClippedTriangle& t)
+{
+    typedef Layout<ColorAttr, UVAttr> Textured;
+    const float attr[3][5] = { { 1, 0, 0, 0, 0 }, { 0, 1, 0, 1, 0 }, { 0, 0, 1, 0, 1 } };
+    Varyings<Textured> v[3];
+    for (int k = 0; k < 3; k++)
+	for (int i = 0; i < Textured::size; i++)
+	    v[k].v[i] = attr[k][i];
+    Varyings<Textured> vt[3];
+    float wt[3];
+    for (int k = 0; k < 3; k++)
+	clipped_varyings(t, k, v, point_w, vt[k], wt[k]);
+    rasterize_varyings(t.setup, vt, wt, [](int x, int y, const Varyings<Textured>& a) {
+	const float* c = a.get<ColorAttr>();
+	const float* uv = a.get<UVAttr>();
+	float s = ((int) (uv[0] * 8) + (int) (uv[1] * 8)) % 2 ? 1.0f : 0.25f;
+	framebuffer.set(x, y, Color(c[0] * s, c[1] * s, c[2] * s));
+    });
+}
+
 void triangle_wireframe(Color color)
 {
     // not much to do.
@@ -359,6 +518,6 @@ void triangle_wireframe(Color color)
     for (int i=0; i<3; i++) {
 	int x0 = points[i].x, y0 = points[i].y;
 	int x1 = points[(i+1)%3].x, y1 = points[(i+1)%3].y;
-	draw_line(x0, y0, x1, y1, color);
+	draw_line(framebuffer, x0, y0, x1, y1, color);
     }
 }
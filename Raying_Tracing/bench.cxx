@@ -0,0 +1,432 @@
+// Rays/sec benchmark of the tracer's stages
+//
+// For every combination of scene size, resolution, thread count,
+// precision and pixel order it times, separately:
+//   traversal  primary rays through the BVH into a G-buffer, visiting
+//              the pixels in the order given (see tiles.h)
+//   shading    Lambert's law (and shadow rays with --shadows) from the G-buffer
+//   output     the framebuffer formatted as P6 and as P3, into a stream
+//              that discards it, so disk speed is not measured
+// and reports rays/sec, BVH work per ray, heap allocations and, where the
+// system has them, cache misses of each stage as JSON. With --tessellate
+// the spheres are traced as triangle meshes instead. The stages run the
+// tracer's own code (tracer.h), the same that template renders with.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+#include "scene.h"
+#include "bvh.h"
+#include "output.h"
+#include "camera.h"
+#include "gbuffer.h"
+#include "tiles.h"
+#include "perf.h"
+#include "tracer.h"
+
+using namespace std;
+
+// every heap allocation of the process goes through here, so each stage
+// can report how many it made
+atomic<long long> allocations(0);
+
+void* operator new(size_t n)
+{
+    allocations++;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+// counts the bytes written to it and throws them away; they are still
+// copied once, into a small scratch buffer, as a file stream would
+struct NullBuf : public streambuf
+{
+    long long bytes = 0;
+    char scratch[1 << 16];
+
+    int overflow(int c)
+    {
+        if (c != EOF) bytes++;
+        return traits_type::not_eof(c);
+    }
+
+    streamsize xsputn(const char* s, streamsize n)
+    {
+        for (streamsize k = 0; k < n; k += sizeof scratch)
+            memcpy(scratch, s + k, (size_t) min<streamsize>(n - k, sizeof scratch));
+        bytes += n;
+        return n;
+    }
+};
+
+struct Stage
+{
+    double ms = numeric_limits<double>::infinity();
+    long long allocs = 0;
+    long long counters[PerfCounters::COUNT];   // -1: not available
+};
+
+PerfCounters* perf;
+
+// fastest of repeat runs of f, with the allocations and counters of that run
+template <typename F>
+Stage time_stage(int repeat, F f)
+{
+    Stage best;
+    for (int r = 0; r < repeat; r++) {
+        long long a0 = allocations;
+        perf->start();
+        auto start = chrono::steady_clock::now();
+        f();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        perf->stop();
+        if (ms < best.ms) {
+            best.ms = ms;
+            best.allocs = allocations - a0;
+            for (int c = 0; c < PerfCounters::COUNT; c++)
+                best.counters[c] = perf->value((PerfCounters::Counter) c);
+        }
+    }
+    return best;
+}
+
+struct Settings
+{
+    vector<int> spheres = {1000, 100000, 1000000};
+    vector<pair<int, int>> res = {{256, 256}, {512, 512}, {1024, 1024}};
+    vector<int> threads;               // default: 1 and all hardware threads
+    vector<string> precision = {"double"};
+    vector<PixelOrder> orders = {ORDER_SCANLINE, ORDER_TILES, ORDER_MORTON};
+    int tile = 16;
+    int tessellate = 0;                // > 0: spheres as meshes of that many segments
+    int repeat = 3;
+    bool shadows = false;
+    string label;
+    string kernel = "auto";
+    string out;                        // JSON file, stdout if empty
+};
+
+const glm::dvec3 EYE(0, 0, 200);
+const glm::dvec3 LIGHT(1500, 1500, 0);
+
+// the scene of master in world<T>(), spheres or, with segments > 0,
+// the triangles of their tessellation
+template <typename T>
+void build_scene(const vector<Sphere>& master, int segments)
+{
+    Mesh m;
+    if (segments > 0) tessellate(master, segments, m);
+    build_world<T>(segments > 0 ? vector<Sphere>() : master, m, EYE, LIGHT);
+}
+
+// intersection tests per second of the kernel alone: a few hundred
+// camera rays against every leaf block of the tree, no traversal
+template <typename T, typename SoA>
+double kernel_mtests(const BVHT<T, SoA>& bvh, const Camera& cam, int repeat)
+{
+    const size_t TESTS = 1 << 25;
+    int nrays = (int) max<size_t>(1, TESTS / max<size_t>(bvh.soa.size(), 1));
+    vector<RayT<T>> rays;
+    for (int k = 0; k < nrays; k++)
+        rays.push_back(RayT<T>(cam.primary((k * 7919) % cam.nx, (k * 104729) % cam.ny)));
+
+    int found = 0;
+    Stage st = time_stage(repeat, [&] {
+        for (auto& r : rays) {
+            T t = numeric_limits<T>::infinity();
+            for (size_t k = 0; k < bvh.soa.size(); k += SoA::BLOCK)
+                found += SoA::intersect(bvh.soa, k, r, t, t) >= 0;
+        }
+    });
+    // keeps the loop from being optimised away
+    if (found < 0) cerr << found;
+    return (double) nrays * bvh.soa.size() / (st.ms * 1e3);
+}
+
+string json_string(const string& s)
+{
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        r += c;
+    }
+    return r + "\"";
+}
+
+void json_stage(ostream& out, const char* name, const Stage& st, double rays, bool last)
+{
+    out << "        " << json_string(name) << ": {\"ms\": " << st.ms
+        << ", \"mrays_per_s\": " << rays / (st.ms * 1e3)
+        << ", \"allocations\": " << st.allocs;
+    for (int c = 0; c < PerfCounters::COUNT; c++) {
+        out << ", \"" << PerfCounters::name((PerfCounters::Counter) c) << "_per_ray\": ";
+        if (st.counters[c] < 0) out << "null";
+        else out << st.counters[c] / rays;
+    }
+    out << "}" << (last ? "\n" : ",\n");
+}
+
+// benchmarks one scene at one resolution for every thread count and
+// pixel order, appending a JSON object per run to runs
+template <typename T>
+void bench_scene(int nx, int ny, const Settings& set, vector<string>& runs)
+{
+    const World<T>& s = world<T>();
+    bool triangles = s.mesh.triangles() > 0;
+    size_t prims = triangles ? s.mesh.triangles() : s.spheres.size();
+    Camera cam(nx, ny, 200, 120, EYE);
+    double rays = (double) nx * ny;
+
+    GBufferT<T> g;
+    g.resize(nx, ny);
+    vector<unsigned char> rgb(g.size() * 3);
+
+    // BVH work per ray does not depend on the thread count or the order:
+    // count it once
+    TraversalStats stats;
+    TileOrder rows(nx, ny, set.tile, ORDER_SCANLINE);
+    for (int k = 0; k < rows.count(); k++)
+        trace_primary(cam, rows, k, g, &stats);
+    long long hits = 0;
+    for (int idx : g.surface)
+        hits += idx >= 0;
+    double tests = (double) (stats.sphere_tests + stats.triangle_tests);
+    double kernel = triangles ? kernel_mtests(s.mesh_bvh, cam, set.repeat)
+                              : kernel_mtests(s.bvh, cam, set.repeat);
+    size_t bvh_nodes = triangles ? s.mesh_bvh.nodes.size() : s.bvh.nodes.size();
+    double build_ms = triangles ? s.mesh_bvh_ms : s.bvh_ms;
+
+    for (int nthreads : set.threads) for (PixelOrder order : set.orders) {
+        TileOrder tiles(nx, ny, set.tile, order);
+        Stage trav = time_stage(set.repeat, [&] {
+            parallel_for(tiles.count(), nthreads, [&](int k, int) {
+                trace_primary(cam, tiles, k, g);
+            });
+        });
+        Stage shading = time_stage(set.repeat, [&] {
+            shade_gbuffer(g, &rgb[0], nthreads);
+        });
+        NullBuf p6buf, p3buf;
+        ostream p6(&p6buf), p3(&p3buf);
+        Stage out_p6 = time_stage(set.repeat, [&] {
+            write_ppm_header(p6, PPM_P6, nx, ny);
+            write_ppm_rows(p6, PPM_P6, &rgb[0], nx, ny);
+        });
+        Stage out_p3 = time_stage(set.repeat, [&] {
+            write_ppm_header(p3, PPM_P3, nx, ny);
+            write_ppm_rows(p3, PPM_P3, &rgb[0], nx, ny);
+        });
+
+        cerr << "bench: " << prims << (triangles ? " triangles " : " spheres ") << nx << "x" << ny
+             << " " << nthreads << " thread(s) " << Precision<T>::name() << " " << order_name(order)
+             << ": traversal " << rays / (trav.ms * 1e3)
+             << " Mrays/s (" << tests / (trav.ms * 1e3) << " Mtests/s), shading " << rays / (shading.ms * 1e3) << " Mrays/s, P6 "
+             << rays / (out_p6.ms * 1e3) << " Mpixels/s, P3 " << rays / (out_p3.ms * 1e3)
+             << " Mpixels/s" << endl;
+
+        ostringstream o;
+        o << "    {\"spheres\": " << s.spheres.size() << ", \"triangles\": " << s.mesh.triangles()
+          << ", \"nx\": " << nx << ", \"ny\": " << ny << ", \"threads\": " << nthreads << ", \"precision\": " << json_string(Precision<T>::name())
+          << ", \"shadows\": " << (set.shadows ? "true" : "false")
+          << ", \"order\": " << json_string(order_name(order)) << ", \"tile\": " << set.tile << ",\n"
+          << "     \"bvh_build_ms\": " << build_ms << ", \"bvh_nodes\": " << bvh_nodes
+          << ", \"primary_rays\": " << (long long) rays << ", \"hit_fraction\": " << hits / rays << ",\n"
+          << "     \"box_tests_per_ray\": " << stats.box_tests / rays
+          << ", \"leaves_per_ray\": " << stats.leaves / rays
+          << ", \"sphere_tests_per_ray\": " << stats.sphere_tests / rays
+          << ", \"triangle_tests_per_ray\": " << stats.triangle_tests / rays << ",\n"
+          << "     \"kernel_mtests_per_s\": " << kernel
+          << ", \"traversal_mtests_per_s\": " << tests / (trav.ms * 1e3);
+        if (triangles)
+            o << ", \"bytes_per_triangle\": {\"mesh\": " << s.mesh.bytes() / (double) prims
+              << ", \"bvh\": " << s.mesh_bvh.bytes() / (double) prims << "}";
+        o << ",\n"
+          << "     \"stages\": {\n";
+        json_stage(o, "traversal", trav, rays, false);
+        json_stage(o, "shading", shading, rays, false);
+        json_stage(o, "output_p6", out_p6, rays, false);
+        json_stage(o, "output_p3", out_p3, rays, true);
+        o << "     },\n"
+          << "     \"output_p6_bytes\": " << p6buf.bytes / set.repeat
+          << ", \"output_p3_bytes\": " << p3buf.bytes / set.repeat << "}";
+        runs.push_back(o.str());
+    }
+}
+
+// "1,2,3"
+bool parse_list(const string& s, vector<int>& v)
+{
+    v.clear();
+    stringstream in(s);
+    string item;
+    while (getline(in, item, ',')) {
+        int n = atoi(item.c_str());
+        if (n < 1) return false;
+        v.push_back(n);
+    }
+    return !v.empty();
+}
+
+// "512,640x480": square or NxM images
+bool parse_res(const string& s, vector<pair<int, int>>& v)
+{
+    v.clear();
+    stringstream in(s);
+    string item;
+    while (getline(in, item, ',')) {
+        int w, h;
+        if (sscanf(item.c_str(), "%dx%d", &w, &h) != 2) h = w = atoi(item.c_str());
+        if (w < 1 || h < 1) return false;
+        v.push_back(make_pair(w, h));
+    }
+    return !v.empty();
+}
+
+void usage()
+{
+    cerr << "Usage:  bench [options]\n"
+         << "  --spheres N,...    scene sizes (default 1000,100000,1000000)\n"
+         << "  --res R,...        resolutions, N or WxH (default 256,512,1024)\n"
+         << "  --threads N,...    thread counts (default 1 and all hardware threads)\n"
+         << "  --precision P,...  double and/or float (default double)\n"
+         << "  --order O,...      pixel orders: scanline, tiles, morton (default all three)\n"
+         << "  --tile N           tile size for tiles and morton (default 16)\n"
+         << "  --tessellate N     trace every sphere as a mesh of N segments around\n"
+         << "  --repeat N         report the fastest of N runs of every stage (default 3)\n"
+         << "  --shadows          cast shadow rays in the shading stage\n"
+         << "  --kernel K         intersection kernel: auto, avx2, sse2 or scalar\n"
+         << "  --label S          stored in the JSON, e.g. the commit benchmarked\n"
+         << "  -o FILE            write the JSON to FILE instead of stdout\n";
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    Settings set;
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        bool more = a + 1 < argc;
+        if (arg == "--spheres" && more) {
+            if (!parse_list(argv[++a], set.spheres)) usage();
+        }
+        else if (arg == "--res" && more) {
+            if (!parse_res(argv[++a], set.res)) usage();
+        }
+        else if (arg == "--threads" && more) {
+            if (!parse_list(argv[++a], set.threads)) usage();
+        }
+        else if (arg == "--precision" && more) {
+            set.precision.clear();
+            stringstream in(argv[++a]);
+            string p;
+            while (getline(in, p, ',')) {
+                if (p != "double" && p != "float") usage();
+                set.precision.push_back(p);
+            }
+        }
+        else if (arg == "--order" && more) {
+            set.orders.clear();
+            stringstream in(argv[++a]);
+            string o;
+            PixelOrder order;
+            while (getline(in, o, ',')) {
+                if (!parse_order(o, order)) usage();
+                set.orders.push_back(order);
+            }
+        }
+        else if (arg == "--tile" && more) {
+            set.tile = atoi(argv[++a]);
+            if (set.tile < 1) usage();
+        }
+        else if (arg == "--tessellate" && more)
+            set.tessellate = max(0, atoi(argv[++a]));
+        else if (arg == "--repeat" && more)
+            set.repeat = max(1, atoi(argv[++a]));
+        else if (arg == "--shadows")
+            set.shadows = true;
+        else if (arg == "--kernel" && more)
+            set.kernel = argv[++a];
+        else if (arg == "--label" && more)
+            set.label = argv[++a];
+        else if (arg == "-o" && more)
+            set.out = argv[++a];
+        else
+            usage();
+    }
+    shadows = set.shadows;
+    if (set.threads.empty()) {
+        set.threads.push_back(1);
+        if (hardware_threads() > 1) set.threads.push_back(hardware_threads());
+    }
+
+    string kernel = select_kernel(set.kernel);
+    if (kernel.empty()) {
+        cerr << "bench: kernel " << set.kernel << " is not available on this CPU" << endl;
+        exit(1);
+    }
+
+    PerfCounters counters;
+    perf = &counters;
+    if (!counters.available(PerfCounters::L1D_MISSES))
+        cerr << "bench: no hardware cache counters on this system, misses are reported as null" << endl;
+
+    vector<string> runs;
+    for (int n : set.spheres) {
+        vector<Sphere> master = random_spheres(n);
+        for (const string& p : set.precision) {
+            if (p == "double") {
+                build_scene<double>(master, set.tessellate);
+                for (auto& r : set.res)
+                    bench_scene<double>(r.first, r.second, set, runs);
+                world_double = World<double>();
+            }
+            else {
+                build_scene<float>(master, set.tessellate);
+                for (auto& r : set.res)
+                    bench_scene<float>(r.first, r.second, set, runs);
+                world_float = World<float>();
+            }
+        }
+    }
+
+    ofstream file;
+    if (!set.out.empty()) {
+        file.open(set.out);
+        if (!file) {
+            cerr << "bench: cannot open " << set.out << endl;
+            exit(1);
+        }
+    }
+    ostream& out = set.out.empty() ? cout : file;
+    out << "{\n"
+        << "  \"label\": " << json_string(set.label) << ",\n"
+        << "  \"kernel\": " << json_string(kernel) << ",\n"
+        << "  \"hardware_threads\": " << hardware_threads() << ",\n"
+        << "  \"repeat\": " << set.repeat << ",\n"
+        << "  \"runs\": [\n";
+    for (size_t k = 0; k < runs.size(); k++)
+        out << runs[k] << (k + 1 < runs.size() ? ",\n" : "\n");
+    out << "  ]\n"
+        << "}\n";
+
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "bvh.h"
+
+#include <limits>
+
+namespace {
+
+template <typename T>
+inline T inf() { return std::numeric_limits<T>::infinity(); }
+
+// 1 + 2 gamma(3), gamma(n) = n u / (1 - n u) with u the unit roundoff:
+// the exit distance of every slab is scaled up by this, so rounding in
+// slab() never culls a box the ray touches (Ize 2013). Without it, a ray
+// through the edge shared by two triangles in different leaves can miss
+// both boxes, which would undo the watertight triangle test.
+template <typename T>
+inline T robust_exit()
+{
+    const T u = std::numeric_limits<T>::epsilon() / 2;
+    return 1 + 2 * (3 * u / (1 - 3 * u));
+}
+
+// entry distance of the ray into b, or infinity if it misses b or enters
+// it only after tmax
+template <typename T>
+inline T slab(const AABBT<T>& b, const glm::tvec3<T>& o, const glm::tvec3<T>& inv, T tmax)
+{
+    T t0 = 0, t1 = tmax;
+    for (int a = 0; a < 3; a++) {
+        T tn = (b.lo[a] - o[a]) * inv[a];
+        T tf = (b.hi[a] - o[a]) * inv[a];
+        if (tn > tf) std::swap(tn, tf);
+        tf *= robust_exit<T>();
+        t0 = tn > t0 ? tn : t0;
+        t1 = tf < t1 ? tf : t1;
+    }
+    return t0 <= t1 ? t0 : inf<T>();
+}
+
+// what build() needs to know about a primitive, for spheres and for the
+// triangles of a mesh
+
+template <typename T>
+size_t prim_count(const std::vector<SphereT<T>>& s) { return s.size(); }
+
+template <typename T>
+size_t prim_count(const MeshT<T>& m) { return m.triangles(); }
+
+template <typename T>
+AABBT<T> prim_box(const std::vector<SphereT<T>>& s, size_t i)
+{
+    glm::tvec3<T> r(s[i].r, s[i].r, s[i].r);
+    AABBT<T> b;
+    b.grow(s[i].p - r);
+    b.grow(s[i].p + r);
+    return b;
+}
+
+template <typename T>
+AABBT<T> prim_box(const MeshT<T>& m, size_t i)
+{
+    AABBT<T> b;
+    for (int k = 0; k < 3; k++)
+        b.grow(m.vertex(i, k));
+    return b;
+}
+
+template <typename T>
+glm::tvec3<T> prim_center(const std::vector<SphereT<T>>& s, size_t i) { return s[i].p; }
+
+template <typename T>
+glm::tvec3<T> prim_center(const MeshT<T>& m, size_t i)
+{
+    return (m.vertex(i, 0) + m.vertex(i, 1) + m.vertex(i, 2)) / T(3);
+}
+
+template <typename T>
+void push_prim(SphereSoAT<T>& soa, const std::vector<SphereT<T>>& s, size_t i) { soa.push(s[i]); }
+
+template <typename T>
+void push_prim(TriangleSoAT<T>& soa, const MeshT<T>& m, size_t i) { soa.push(m, i); }
+
+}
+
+template <typename T>
+AABBT<T>::AABBT() : lo(inf<T>(), inf<T>(), inf<T>()), hi(-inf<T>(), -inf<T>(), -inf<T>()) {}
+
+template <typename T>
+void AABBT<T>::grow(const vec& p)
+{
+    for (int a = 0; a < 3; a++) {
+        lo[a] = std::min(lo[a], p[a]);
+        hi[a] = std::max(hi[a], p[a]);
+    }
+}
+
+template <typename T>
+void AABBT<T>::grow(const AABBT& b)
+{
+    grow(b.lo);
+    grow(b.hi);
+}
+
+template <typename T>
+T AABBT<T>::area() const
+{
+    if (lo[0] > hi[0]) return 0;
+    vec e = hi - lo;
+    return 2 * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+}
+
+template <typename T, typename SoA>
+void BVHT<T, SoA>::build(const typename SoA::Source& s)
+{
+    size_t count = prim_count(s);
+    nodes.clear();
+    soa.clear();
+    prims.resize(count);
+    // an empty tree has no root, which intersect() and occluded() check
+    if (count == 0) return;
+
+    std::vector<AABBT<T>> bounds(count);
+    std::vector<vec> centers(count);
+    for (size_t i = 0; i < count; i++) {
+        prims[i] = (int) i;
+        bounds[i] = prim_box(s, i);
+        centers[i] = prim_center(s, i);
+    }
+
+    // a binary tree with n leaves has at most 2n - 1 nodes
+    nodes.reserve(2 * count + 1);
+    Node root;
+    root.first = 0;
+    root.count = (int) count;
+    nodes.push_back(root);
+    subdivide(0, 1, bounds, centers);
+
+    // give every leaf its own block of BLOCK slots, so a leaf is tested
+    // with a single kernel call
+    std::vector<int> packed;
+    for (auto& n : nodes) {
+        if (n.count == 0) continue;
+        int at = (int) packed.size();
+        for (int k = n.first; k < n.first + n.count; k++) {
+            packed.push_back(prims[k]);
+            push_prim(soa, s, prims[k]);
+        }
+        while (packed.size() % SoA::BLOCK)
+            packed.push_back(-1);
+        soa.pad();
+        n.first = at;
+    }
+    prims.swap(packed);
+}
+
+template <typename T, typename SoA>
+void BVHT<T, SoA>::subdivide(int node, int level, const std::vector<AABBT<T>>& bounds, const std::vector<vec>& centers)
+{
+    int first = nodes[node].first;
+    int count = nodes[node].count;
+
+    AABBT<T> box, cbox;
+    for (int k = first; k < first + count; k++) {
+        box.grow(bounds[prims[k]]);
+        cbox.grow(centers[prims[k]]);
+    }
+    nodes[node].box = box;
+    if (count <= 1) return;
+
+    // widest axis of the centroids
+    vec ext = cbox.hi - cbox.lo;
+    int axis = 0;
+    if (ext[1] > ext[axis]) axis = 1;
+    if (ext[2] > ext[axis]) axis = 2;
+    if (ext[axis] <= 0) {
+        // all centers coincide, nothing to split on
+        if (count <= MAX_LEAF) return;
+    }
+
+    // bin the centroids
+    AABBT<T> bin_box[BINS];
+    int bin_count[BINS] = {0};
+    T scale = ext[axis] > 0 ? BINS / ext[axis] : 0;
+    auto bin_of = [&](int i) {
+        int b = (int) ((centers[i][axis] - cbox.lo[axis]) * scale);
+        return b < BINS ? b : BINS - 1;
+    };
+    for (int k = first; k < first + count; k++) {
+        int b = bin_of(prims[k]);
+        bin_box[b].grow(bounds[prims[k]]);
+        bin_count[b]++;
+    }
+
+    // sweep from both sides to get the cost of every split between bins:
+    // cost = area(left) * n(left) + area(right) * n(right), in units of
+    // one primitive test scaled by the parent area
+    T right_cost[BINS];
+    AABBT<T> acc;
+    int n = 0;
+    for (int b = BINS - 1; b > 0; b--) {
+        acc.grow(bin_box[b]);
+        n += bin_count[b];
+        right_cost[b] = n * acc.area();
+    }
+    T best = std::numeric_limits<T>::max();
+    int split = -1;
+    acc = AABBT<T>();
+    n = 0;
+    for (int b = 0; b < BINS - 1; b++) {
+        acc.grow(bin_box[b]);
+        n += bin_count[b];
+        if (n == 0 || n == count) continue;
+        T c = n * acc.area() + right_cost[b + 1];
+        if (c < best) {
+            best = c;
+            split = b;
+        }
+    }
+
+    // traversal step is taken as about as expensive as one primitive test
+    T leaf_cost = count * box.area();
+    T split_cost = box.area() + best;
+    int mid;
+    if (split >= 0 && level < MAX_SAH_DEPTH && (split_cost < leaf_cost || count > MAX_LEAF)) {
+        int* p = std::partition(&prims[first], &prims[first] + count,
+                                [&](int i) { return bin_of(i) <= split; });
+        mid = (int) (p - &prims[0]);
+    }
+    else if (count > MAX_LEAF) {
+        // SAH found no usable split (e.g. coincident centers) or the tree
+        // got too deep: median split, which bounds the remaining depth
+        mid = first + count / 2;
+        std::nth_element(&prims[first], &prims[mid], &prims[first] + count,
+                         [&](int i, int j) { return centers[i][axis] < centers[j][axis]; });
+    }
+    else {
+        return;
+    }
+
+    int left = (int) nodes.size();
+    Node l, r;
+    l.first = first;
+    l.count = mid - first;
+    r.first = mid;
+    r.count = first + count - mid;
+    nodes.push_back(l);
+    nodes.push_back(r);
+    nodes[node].first = left;
+    nodes[node].count = 0;
+
+    subdivide(left, level + 1, bounds, centers);
+    subdivide(left + 1, level + 1, bounds, centers);
+}
+
+template <typename T, typename SoA>
+bool BVHT<T, SoA>::intersect(const RayT<T>& ray, T& t, int& surface_idx) const
+{
+    return closest<false>(ray, t, surface_idx, nullptr);
+}
+
+template <typename T, typename SoA>
+bool BVHT<T, SoA>::intersect(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats& stats) const
+{
+    return closest<true>(ray, t, surface_idx, &stats);
+}
+
+template <typename T, typename SoA>
+template <bool COUNT>
+bool BVHT<T, SoA>::closest(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats* stats) const
+{
+    if (nodes.empty()) return false;
+
+    const T INF = inf<T>();
+    vec inv(1 / ray.d[0], 1 / ray.d[1], 1 / ray.d[2]);
+    T best = INF;
+    bool found = false;
+
+    // pending nodes along with their entry distance
+    struct Entry { int node; T tnear; };
+    Entry stack[STACK_SIZE];
+    int sp = 0;
+
+    T troot = slab(nodes[0].box, ray.o, inv, best);
+    if (COUNT) stats->box_tests++;
+    if (troot == INF) return false;
+    stack[sp++] = Entry{0, troot};
+
+    while (sp > 0) {
+        Entry e = stack[--sp];
+        // a closer hit was found after this node was pushed
+        if (e.tnear >= best) continue;
+
+        const Node* n = &nodes[e.node];
+        while (n->count == 0) {
+            const Node* a = &nodes[n->first];
+            const Node* b = a + 1;
+            T ta = slab(a->box, ray.o, inv, best);
+            T tb = slab(b->box, ray.o, inv, best);
+            if (COUNT) stats->box_tests += 2;
+            if (tb < ta) {
+                std::swap(a, b);
+                std::swap(ta, tb);
+            }
+            if (ta == INF) {
+                n = nullptr;
+                break;
+            }
+            // descend into the nearer child, come back to the farther one
+            if (tb != INF) stack[sp++] = Entry{(int) (b - &nodes[0]), tb};
+            n = a;
+        }
+        if (!n) continue;
+
+        int lane = SoA::intersect(soa, n->first, ray, best, best);
+        if (COUNT) {
+            stats->leaves++;
+            stats->tests(soa) += SoA::BLOCK;
+        }
+        if (lane >= 0) {
+            surface_idx = prims[n->first + lane];
+            found = true;
+        }
+    }
+
+    if (found) t = best;
+    return found;
+}
+
+template <typename T, typename SoA>
+bool BVHT<T, SoA>::occluded(const RayT<T>& ray, T tmax) const
+{
+    if (nodes.empty()) return false;
+
+    const T INF = inf<T>();
+    vec inv(1 / ray.d[0], 1 / ray.d[1], 1 / ray.d[2]);
+    int stack[STACK_SIZE];
+    int sp = 0;
+    T t;
+
+    if (slab(nodes[0].box, ray.o, inv, tmax) == INF) return false;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const Node& n = nodes[stack[--sp]];
+        if (n.count > 0) {
+            if (SoA::intersect(soa, n.first, ray, tmax, t) >= 0) return true;
+            continue;
+        }
+        if (slab(nodes[n.first + 1].box, ray.o, inv, tmax) != INF) stack[sp++] = n.first + 1;
+        if (slab(nodes[n.first].box, ray.o, inv, tmax) != INF) stack[sp++] = n.first;
+    }
+    return false;
+}
+
+template <typename T, typename SoA>
+int BVHT<T, SoA>::depth() const
+{
+    if (nodes.empty()) return 0;
+    // iterative walk, (node, depth) pairs
+    std::vector<std::pair<int, int>> todo(1, std::make_pair(0, 1));
+    int deepest = 0;
+    while (!todo.empty()) {
+        std::pair<int, int> e = todo.back();
+        todo.pop_back();
+        deepest = std::max(deepest, e.second);
+        if (nodes[e.first].count == 0) {
+            todo.push_back(std::make_pair(nodes[e.first].first, e.second + 1));
+            todo.push_back(std::make_pair(nodes[e.first].first + 1, e.second + 1));
+        }
+    }
+    return deepest;
+}
+
+template <typename T, typename SoA>
+size_t BVHT<T, SoA>::bytes() const
+{
+    return nodes.size() * sizeof(Node) + prims.size() * sizeof(int) + soa.bytes();
+}
+
+template struct AABBT<float>;
+template struct AABBT<double>;
+template struct BVHT<float>;
+template struct BVHT<double>;
+template struct BVHT<float, TriangleSoAT<float>>;
+template struct BVHT<double, TriangleSoAT<double>>;
@@ -0,0 +1,103 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "scene.h"
+#include "soa.h"
+
+// axis aligned box
+template <typename T>
+struct AABBT
+{
+    typedef glm::tvec3<T> vec;
+
+    vec lo, hi;
+
+    AABBT();
+    void grow(const vec& p);
+    void grow(const AABBT& b);
+    T area() const;   // surface area, 0 for an empty box
+};
+
+// work done by BVHT::intersect(), summed over any number of rays
+struct TraversalStats
+{
+    long long rays = 0;           // counted by the caller: one ray may walk several trees
+    long long box_tests = 0;      // node boxes tested against a ray
+    long long leaves = 0;         // leaf blocks handed to the intersection kernel
+    long long sphere_tests = 0;   // spheres in those blocks, padding slots included
+    long long triangle_tests = 0; // the same for triangles
+
+    // the test counter of the primitives in soa
+    template <typename T> long long& tests(const SphereSoAT<T>&) { return sphere_tests; }
+    template <typename T> long long& tests(const TriangleSoAT<T>&) { return triangle_tests; }
+};
+
+// Bounding volume hierarchy over the spheres of a scene, or with
+// SoA = TriangleSoAT<T> over the triangles of a mesh (MeshBVHT).
+//
+// Built top-down with binned SAH: at every node the primitive centroids
+// are dropped into a fixed number of bins along the widest axis and the
+// split between bins with the lowest surface area cost is taken, or the
+// node becomes a leaf when no split is cheaper than testing all its
+// primitives.
+//
+// Instantiated for float and double; the float tree has half the node
+// size and twice the primitives per leaf (one SIMD block either way).
+template <typename T, typename SoA = SphereSoAT<T>>
+struct BVHT
+{
+    typedef glm::tvec3<T> vec;
+
+    struct Node
+    {
+        AABBT<T> box;
+        int first;   // leaf: first entry in prims, interior: left child (right child is first + 1)
+        int count;   // number of primitives in a leaf, 0 for an interior node
+    };
+
+    static const int BINS = 16;
+    static const int MAX_LEAF = SoA::BLOCK;
+    // below this depth only median splits are made, which keeps every
+    // tree under STACK_SIZE levels for any realistic primitive count
+    static const int MAX_SAH_DEPTH = 32;
+    static const int STACK_SIZE = 64;
+
+    std::vector<Node> nodes;      // nodes[0] is the root
+    std::vector<int> prims;       // sphere (triangle) indices, one block per leaf, -1 = unused slot
+    SoA soa;                      // geometry of prims, same layout
+
+    // s is the sphere list, or the mesh for a MeshBVHT
+    void build(const typename SoA::Source& s);
+
+    // closest hit with t > eps, same contract as hit() in template.cxx
+    bool intersect(const RayT<T>& ray, T& t, int& surface_idx) const;
+
+    // the same, counting the work into stats (for benchmarks; the plain
+    // version above does not pay for the counting)
+    bool intersect(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats& stats) const;
+
+    // true if anything is hit with eps < t < tmax; stops at the first
+    // such hit and does not order the children, so it is cheaper than
+    // intersect() for shadow rays
+    bool occluded(const RayT<T>& ray, T tmax) const;
+
+    int depth() const;
+
+    // bytes of nodes, prims and soa
+    size_t bytes() const;
+
+private:
+    template <bool COUNT>
+    bool closest(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats* stats) const;
+
+    void subdivide(int node, int level, const std::vector<AABBT<T>>& bounds, const std::vector<vec>& centers);
+};
+
+template <typename T>
+using MeshBVHT = BVHT<T, TriangleSoAT<T>>;
+
+typedef BVHT<double> BVH;
+typedef MeshBVHT<double> MeshBVH;
+
+#endif
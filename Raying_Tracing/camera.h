@@ -0,0 +1,38 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <cmath>
+#include "scene.h"
+
+// maps the virtual film onto pixels
+struct Camera
+{
+    int nx, ny;
+    double scalef;   // world units per pixel
+    vec3 eye;        // camera position
+
+    Camera(int nx, int ny, int d, double theta, const vec3& eye)
+        : nx(nx), ny(ny), eye(eye)
+    {
+        double h = (2.0 * d * (std::tan(theta / 2.0)));
+        double w =  (nx / (double) ny) * h;
+        scalef = w / (double) nx;
+    }
+
+    // ray from the eye through the point (x, y) of the film, in pixels;
+    // pixel (i, j) is centered on x = i, y = j
+    Ray primary(double x, double y) const
+    {
+        vec3 point;
+
+        // transform: translate, scale
+        point[0] = (x + (-nx / 2.0)) * scalef;
+        point[1] = (y + (-ny / 2.0)) * scalef;
+        point[2] = 0;
+
+        vec3 worldn = glm::normalize(point - eye);
+        return Ray(eye, worldn);
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "cost.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "output.h"
+
+namespace {
+
+// value at fraction p of the sorted values
+double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+std::vector<double> values(const std::vector<PixelCost>& cost, CostMetric m)
+{
+    std::vector<double> v(cost.size());
+    for (size_t k = 0; k < cost.size(); k++)
+        v[k] = cost_value(cost[k], m);
+    return v;
+}
+
+// jet-like color scale, x in [0, 1]
+void heat(double x, unsigned char* rgb)
+{
+    static const double stops[6][3] = {
+        {0, 0, .5}, {0, 0, 1}, {0, 1, 1}, {1, 1, 0}, {1, 0, 0}, {.5, 0, 0}
+    };
+    x = std::min(std::max(x, 0.0), 1.0) * 5;
+    int s = std::min((int) x, 4);
+    double f = x - s;
+    for (int c = 0; c < 3; c++)
+        rgb[c] = (unsigned char) (255 * (stops[s][c] + f * (stops[s + 1][c] - stops[s][c])) + 0.5);
+}
+
+}
+
+bool parse_cost_metric(const std::string& s, CostMetric& m)
+{
+    if (s == "tests") m = COST_TESTS;
+    else if (s == "steps") m = COST_STEPS;
+    else if (s == "shade") m = COST_SHADE;
+    else return false;
+    return true;
+}
+
+const char* cost_metric_name(CostMetric m)
+{
+    switch (m) {
+    case COST_TESTS: return "tests";
+    case COST_STEPS: return "steps";
+    default: return "shade";
+    }
+}
+
+double cost_value(const PixelCost& c, CostMetric m)
+{
+    switch (m) {
+    case COST_TESTS: return (double) (c.trav.sphere_tests + c.trav.triangle_tests);
+    case COST_STEPS: return (double) c.trav.box_tests;
+    default: return (double) c.shade_ns;
+    }
+}
+
+void write_cost_map(std::ostream& out, const std::vector<PixelCost>& cost, int nx, int ny, CostMetric m)
+{
+    std::vector<double> v = values(cost, m);
+    double top = percentile(v, 0.99);
+    if (top <= 0) top = 1;
+
+    std::vector<unsigned char> rgb(v.size() * 3);
+    for (size_t k = 0; k < v.size(); k++)
+        heat(v[k] / top, &rgb[k * 3]);
+    write_ppm_header(out, PPM_P6, nx, ny);
+    write_ppm_rows(out, PPM_P6, &rgb[0], nx, ny);
+}
+
+void print_cost_summary(std::ostream& out, const std::vector<PixelCost>& cost)
+{
+    const int BINS = 16, WIDTH = 40;
+
+    for (CostMetric m : {COST_TESTS, COST_STEPS, COST_SHADE}) {
+        std::vector<double> v = values(cost, m);
+        double sum = 0, top = 0;
+        for (double x : v) {
+            sum += x;
+            top = std::max(top, x);
+        }
+        out << "cost: " << cost_metric_name(m) << (m == COST_SHADE ? " (ns)" : "") << " per pixel: mean "
+            << sum / std::max<size_t>(v.size(), 1) << ", p50 " << percentile(v, 0.5) << ", p90 "
+            << percentile(v, 0.9) << ", p99 " << percentile(v, 0.99) << ", max " << top << "\n";
+
+        // BINS equal bins over [0, max]
+        std::vector<long long> bins(BINS, 0);
+        for (double x : v)
+            bins[std::min(BINS - 1, (int) (x / (top > 0 ? top : 1) * BINS))]++;
+        long long most = *std::max_element(bins.begin(), bins.end());
+        for (int b = 0; b < BINS; b++) {
+            int bar = most > 0 ? (int) (WIDTH * bins[b] / most) : 0;
+            out << "cost:   " << std::setw(10) << top * b / BINS << " - " << std::setw(10)
+                << top * (b + 1) / BINS << " " << std::setw(8) << bins[b] << " "
+                << std::string(bar, '#') << "\n";
+        }
+    }
+    out.flush();
+}
@@ -0,0 +1,39 @@
+#ifndef COST_H
+#define COST_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bvh.h"
+
+// Work done to render one pixel, collected when the tracer is built with
+// -DTRACER_COST (make template_cost): BVH traversal of the pixel's
+// camera rays and the time spent shading its hits (shadow rays included).
+struct PixelCost
+{
+    TraversalStats trav;
+    long long shade_ns = 0;
+};
+
+enum CostMetric
+{
+    COST_TESTS,   // sphere and triangle intersection tests
+    COST_STEPS,   // traversal steps (node boxes tested)
+    COST_SHADE    // shading time in ns
+};
+
+// "tests", "steps" or "shade"; false for anything else
+bool parse_cost_metric(const std::string& s, CostMetric& m);
+const char* cost_metric_name(CostMetric m);
+
+double cost_value(const PixelCost& c, CostMetric m);
+
+// false-color P6 image of metric m, from dark blue (0) over cyan and
+// yellow to dark red; the 99th percentile is the top of the scale, so a
+// few extreme pixels do not wash out the rest
+void write_cost_map(std::ostream& out, const std::vector<PixelCost>& cost, int nx, int ny, CostMetric m);
+
+// mean, percentiles and a histogram of every metric
+void print_cost_summary(std::ostream& out, const std::vector<PixelCost>& cost);
+
+#endif
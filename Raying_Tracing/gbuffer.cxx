@@ -0,0 +1,107 @@
+#include "gbuffer.h"
+
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// As in soa.cxx, the AVX2 loops evaluate the scalar expressions in the
+// same order without fused multiply-adds, so both give the same bits.
+
+namespace {
+
+template <typename T>
+void lambert_scalar(const GBufferT<T>& g, const glm::tvec3<T>& light, size_t begin, size_t end, T* out)
+{
+    for (size_t k = begin; k < end; k++) {
+        T lx = light[0] - g.pos[0][k];
+        T ly = light[1] - g.pos[1][k];
+        T lz = light[2] - g.pos[2][k];
+        T dist = std::sqrt(lx * lx + ly * ly + lz * lz);
+        lx = lx / dist;
+        ly = ly / dist;
+        lz = lz / dist;
+        T c = g.normal[0][k] * lx + g.normal[1][k] * ly + g.normal[2][k] * lz;
+        out[k] = c > 0 ? c : 0;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+bool have_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+// double, 4 pixels per iteration
+__attribute__((target("avx2")))
+void lambert_avx2(const GBufferT<double>& g, const glm::dvec3& light, size_t begin, size_t end, double* out)
+{
+    const __m256d lx = _mm256_set1_pd(light[0]), ly = _mm256_set1_pd(light[1]), lz = _mm256_set1_pd(light[2]);
+    const __m256d zero = _mm256_setzero_pd();
+
+    size_t k = begin;
+    for (; k + 4 <= end; k += 4) {
+        __m256d dx = _mm256_sub_pd(lx, _mm256_loadu_pd(&g.pos[0][k]));
+        __m256d dy = _mm256_sub_pd(ly, _mm256_loadu_pd(&g.pos[1][k]));
+        __m256d dz = _mm256_sub_pd(lz, _mm256_loadu_pd(&g.pos[2][k]));
+        __m256d dist = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                                    _mm256_mul_pd(dz, dz)));
+        dx = _mm256_div_pd(dx, dist);
+        dy = _mm256_div_pd(dy, dist);
+        dz = _mm256_div_pd(dz, dist);
+        __m256d c = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&g.normal[0][k]), dx),
+                                                _mm256_mul_pd(_mm256_loadu_pd(&g.normal[1][k]), dy)),
+                                  _mm256_mul_pd(_mm256_loadu_pd(&g.normal[2][k]), dz));
+        // c where c > 0, else +0 (also for the NaNs of missed pixels)
+        _mm256_storeu_pd(&out[k], _mm256_and_pd(c, _mm256_cmp_pd(c, zero, _CMP_GT_OQ)));
+    }
+    lambert_scalar(g, light, k, end, out);
+}
+
+// float, 8 pixels per iteration
+__attribute__((target("avx2")))
+void lambert_avx2(const GBufferT<float>& g, const glm::vec3& light, size_t begin, size_t end, float* out)
+{
+    const __m256 lx = _mm256_set1_ps(light[0]), ly = _mm256_set1_ps(light[1]), lz = _mm256_set1_ps(light[2]);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t k = begin;
+    for (; k + 8 <= end; k += 8) {
+        __m256 dx = _mm256_sub_ps(lx, _mm256_loadu_ps(&g.pos[0][k]));
+        __m256 dy = _mm256_sub_ps(ly, _mm256_loadu_ps(&g.pos[1][k]));
+        __m256 dz = _mm256_sub_ps(lz, _mm256_loadu_ps(&g.pos[2][k]));
+        __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                                   _mm256_mul_ps(dz, dz)));
+        dx = _mm256_div_ps(dx, dist);
+        dy = _mm256_div_ps(dy, dist);
+        dz = _mm256_div_ps(dz, dist);
+        __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&g.normal[0][k]), dx),
+                                               _mm256_mul_ps(_mm256_loadu_ps(&g.normal[1][k]), dy)),
+                                 _mm256_mul_ps(_mm256_loadu_ps(&g.normal[2][k]), dz));
+        _mm256_storeu_ps(&out[k], _mm256_and_ps(c, _mm256_cmp_ps(c, zero, _CMP_GT_OQ)));
+    }
+    lambert_scalar(g, light, k, end, out);
+}
+
+#endif
+
+}
+
+template <typename T>
+void lambert_pass(const GBufferT<T>& g, const glm::tvec3<T>& light, size_t begin, size_t end, T* out)
+{
+#ifdef HAVE_X86_KERNELS
+    static const bool avx2 = have_avx2();
+    if (avx2) {
+        lambert_avx2(g, light, begin, end, out);
+        return;
+    }
+#endif
+    lambert_scalar(g, light, begin, end, out);
+}
+
+template void lambert_pass(const GBufferT<double>&, const glm::dvec3&, size_t, size_t, double*);
+template void lambert_pass(const GBufferT<float>&, const glm::vec3&, size_t, size_t, float*);
@@ -0,0 +1,65 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// What the primary ray of every pixel hit, kept so the image can be
+// shaded again for another light without tracing a single primary ray.
+//
+// One array per attribute (x, y and z of the hit point, of the normal
+// and of the surface color, the distance t and the surface index), so
+// shading is a straight loop over the arrays. Pixels whose ray missed
+// have surface -1 and everything else 0.
+template <typename T>
+struct GBufferT
+{
+    typedef glm::tvec3<T> vec;
+
+    int nx = 0, ny = 0;
+    std::vector<T> pos[3];       // hit point
+    std::vector<T> normal[3];    // unit surface normal at pos
+    std::vector<T> albedo[3];    // surface color
+    std::vector<T> t;            // distance along the primary ray
+    std::vector<int> surface;    // sphere index, -1 for a miss
+
+    void resize(int w, int h)
+    {
+        nx = w;
+        ny = h;
+        size_t n = (size_t) w * h;
+        for (int a = 0; a < 3; a++) {
+            pos[a].assign(n, 0);
+            normal[a].assign(n, 0);
+            albedo[a].assign(n, 0);
+        }
+        t.assign(n, 0);
+        surface.assign(n, -1);
+    }
+
+    size_t size() const { return surface.size(); }
+
+    void set(size_t k, int idx, T dist, const vec& p, const vec& n, const vec& c)
+    {
+        for (int a = 0; a < 3; a++) {
+            pos[a][k] = p[a];
+            normal[a][k] = n[a];
+            albedo[a][k] = c[a];
+        }
+        t[k] = dist;
+        surface[k] = idx;
+    }
+
+    vec position(size_t k) const { return vec(pos[0][k], pos[1][k], pos[2][k]); }
+};
+
+// Lambert's cosine term of pixels [begin, end) for a light at light, into
+// out[begin, end) (out has one entry per pixel); 0 where the light is
+// behind the surface or the pixel is a miss.
+// Same arithmetic as lambert() in template.cxx, vectorized with AVX2 when
+// the CPU has it; the result does not depend on which path runs.
+template <typename T>
+void lambert_pass(const GBufferT<T>& g, const glm::tvec3<T>& light, size_t begin, size_t end, T* out);
+
+#endif
@@ -0,0 +1,121 @@
+#include "output.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+void write_ppm_header(std::ostream& out, PPMFormat fmt, int nx, int ny)
+{
+    out << (fmt == PPM_P6 ? "P6\n" : "P3\n") << nx << " " << ny << "\n" << "255\n";
+}
+
+bool read_ppm(std::istream& in, int& nx, int& ny, std::vector<unsigned char>& rgb)
+{
+    std::string magic;
+    int maxval;
+    if (!(in >> magic >> nx >> ny >> maxval) || magic != "P6" || nx < 1 || ny < 1 || maxval != 255)
+        return false;
+    in.get();   // the one whitespace before the pixels
+    rgb.resize((size_t) nx * ny * 3);
+    return (bool) in.read((char*) &rgb[0], rgb.size());
+}
+
+void write_ppm_rows(std::ostream& out, PPMFormat fmt, const unsigned char* rgb, int nx, int n)
+{
+    size_t bytes = (size_t) nx * n * 3;
+    if (fmt == PPM_P6) {
+        out.write((const char*) rgb, bytes);
+        return;
+    }
+
+    // P3: "r g b " per pixel and a newline per row, formatted through a
+    // table of the 256 possible "v " strings instead of operator<<
+    static struct Table {
+        char text[256][4];
+        unsigned char len[256];
+        Table()
+        {
+            for (int v = 0; v < 256; v++) {
+                int l = 0;
+                if (v >= 100) text[v][l++] = '0' + v / 100;
+                if (v >= 10) text[v][l++] = '0' + v / 10 % 10;
+                text[v][l++] = '0' + v % 10;
+                text[v][l++] = ' ';
+                len[v] = (unsigned char) l;
+            }
+        }
+    } table;
+
+    std::vector<char> line((size_t) nx * 3 * 4 + 1);
+    for (int j = 0; j < n; j++) {
+        char* p = &line[0];
+        const unsigned char* row = rgb + (size_t) j * nx * 3;
+        for (int i = 0; i < nx * 3; i++) {
+            memcpy(p, table.text[row[i]], 4);
+            p += table.len[row[i]];
+        }
+        *p++ = '\n';
+        out.write(&line[0], p - &line[0]);
+    }
+}
+
+RowWriter::RowWriter(std::ostream& out, PPMFormat fmt, int nx, int ny, size_t capacity)
+    : out(out), fmt(fmt), nx(nx), ny(ny), capacity(capacity > 0 ? capacity : 1),
+      done(0)
+{
+    write_ppm_header(out, fmt, nx, ny);
+    // no rows will come for an empty image, so there is nothing to wait for
+    if (ny > 0) worker = std::thread(&RowWriter::run, this);
+}
+
+RowWriter::~RowWriter()
+{
+    finish();
+}
+
+void RowWriter::push(const unsigned char* rgb, int nrows)
+{
+    std::unique_lock<std::mutex> g(lock);
+    not_full.wait(g, [&] { return queue.size() < capacity; });
+    queue.push_back(Rows{rgb, nrows});
+    not_empty.notify_one();
+}
+
+int RowWriter::written()
+{
+    std::lock_guard<std::mutex> g(lock);
+    return done;
+}
+
+void RowWriter::wait_written(int rows)
+{
+    std::unique_lock<std::mutex> g(lock);
+    progress.wait(g, [&] { return done >= rows; });
+}
+
+void RowWriter::finish()
+{
+    if (worker.joinable())
+        worker.join();
+    out.flush();
+}
+
+void RowWriter::run()
+{
+    while (done < ny) {
+        Rows r;
+        {
+            std::unique_lock<std::mutex> g(lock);
+            not_empty.wait(g, [&] { return !queue.empty(); });
+            r = queue.front();
+            queue.pop_front();
+            not_full.notify_one();
+        }
+
+        write_ppm_rows(out, fmt, r.rgb, nx, r.n);
+
+        std::lock_guard<std::mutex> g(lock);
+        done += r.n;
+        progress.notify_all();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// ppm flavors: ASCII (P3) or binary (P6), both with 255 as max value
+enum PPMFormat { PPM_P3, PPM_P6 };
+
+void write_ppm_header(std::ostream& out, PPMFormat fmt, int nx, int ny);
+
+// writes n rows of packed 8-bit RGB, nx pixels each
+void write_ppm_rows(std::ostream& out, PPMFormat fmt, const unsigned char* rgb, int nx, int n);
+
+// reads a P6 image with 255 as max value, as written above, into rgb;
+// false if in does not hold one
+bool read_ppm(std::istream& in, int& nx, int& ny, std::vector<unsigned char>& rgb);
+
+// Writes rows of an image to out on a dedicated thread, so formatting and
+// I/O overlap with tracing.
+//
+// Rows are handed over with push() in top to bottom order through a queue
+// of at most capacity entries; push() blocks while the queue is full.
+// The pixels are not copied: they must stay valid until finish() returns
+// (or until the writer has written them, see written()).
+class RowWriter
+{
+public:
+    RowWriter(std::ostream& out, PPMFormat fmt, int nx, int ny, size_t capacity = 16);
+    ~RowWriter();
+
+    void push(const unsigned char* rgb, int nrows);
+
+    // rows written out so far
+    int written();
+
+    // waits until at least rows rows have been written, after which
+    // their pixels may be reused
+    void wait_written(int rows);
+
+    // waits until all ny rows have been written
+    void finish();
+
+private:
+    struct Rows { const unsigned char* rgb; int n; };
+
+    void run();
+
+    std::ostream& out;
+    PPMFormat fmt;
+    int nx, ny;
+    size_t capacity;
+
+    std::mutex lock;
+    std::condition_variable not_full, not_empty, progress;
+    std::deque<Rows> queue;
+    int done;
+
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "parallel.h"
+
+#include <algorithm>
+
+bool ThreadPool::JobQueue::pop_front(int& k)
+{
+    std::lock_guard<std::mutex> g(lock);
+    if (begin >= end) return false;
+    k = begin++;
+    return true;
+}
+
+bool ThreadPool::JobQueue::pop_back(int& k)
+{
+    std::lock_guard<std::mutex> g(lock);
+    if (begin >= end) return false;
+    k = --end;
+    return true;
+}
+
+int ThreadPool::JobQueue::size()
+{
+    std::lock_guard<std::mutex> g(lock);
+    return end - begin;
+}
+
+ThreadPool::ThreadPool(int nthreads) : queues(std::max(nthreads, 1))
+{
+    threads.reserve(size() - 1);
+    for (int w = 1; w < size(); w++)
+        threads.emplace_back(&ThreadPool::loop, this, w);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> g(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+// steal one job from the worker with the most work left
+bool ThreadPool::steal(int self, int& k)
+{
+    for (;;) {
+        int victim = -1, most = 0;
+        for (int v = 0; v < size(); v++) {
+            if (v == self) continue;
+            int n = queues[v].size();
+            if (n > most) {
+                most = n;
+                victim = v;
+            }
+        }
+        if (victim < 0) return false;
+        if (queues[victim].pop_back(k)) return true;
+        // victim drained in the meantime, look again
+    }
+}
+
+void ThreadPool::work(int self)
+{
+    int k;
+    while (queues[self].pop_front(k) || steal(self, k))
+        (*job)(k, self);
+}
+
+// a worker thread: one work() per run, until the pool is destroyed
+void ThreadPool::loop(int self)
+{
+    long long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> g(lock);
+            wake.wait(g, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+        }
+        work(self);
+        std::lock_guard<std::mutex> g(lock);
+        if (--busy == 0) idle.notify_one();
+    }
+}
+
+void ThreadPool::run(int njobs, const std::function<void(int job, int worker)>& job)
+{
+    if (threads.empty() || njobs <= 1) {
+        for (int k = 0; k < njobs; k++)
+            job(k, 0);
+        return;
+    }
+
+    int n = size();
+    {
+        std::lock_guard<std::mutex> g(lock);
+        for (int w = 0; w < n; w++) {
+            queues[w].begin = (int) ((long long) njobs * w / n);
+            queues[w].end = (int) ((long long) njobs * (w + 1) / n);
+        }
+        this->job = &job;
+        busy = (int) threads.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+    std::unique_lock<std::mutex> g(lock);
+    idle.wait(g, [&] { return busy == 0; });
+}
+
+void parallel_for(int njobs, int nthreads,
+                  const std::function<void(int job, int worker)>& job)
+{
+    // no threads for what would run on one anyway
+    ThreadPool pool(std::min(nthreads, njobs));
+    pool.run(njobs, job);
+}
+
+int hardware_threads()
+{
+    int n = (int) std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
@@ -0,0 +1,74 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that runs job(k) for every k in
+// [0, njobs), one run() after another, without starting new threads.
+//
+// Jobs are dealt out to the workers in contiguous blocks. Every worker
+// pops jobs from the front of its own block, and once that runs dry it
+// steals from the back of the busiest other block, so uneven jobs (e.g.
+// tiles that cover many spheres vs. empty background) still keep every
+// core busy. job is called with the index of the worker running it; the
+// thread calling run() is worker 0.
+//
+// A pool of nthreads <= 1 runs everything on the calling thread, in
+// order. run() is not reentrant: a job must not call run() on its own
+// pool.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int nthreads);
+    ~ThreadPool();
+
+    int size() const { return (int) queues.size(); }
+
+    void run(int njobs, const std::function<void(int job, int worker)>& job);
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    // [begin, end) range of jobs owned by one worker.
+    // the owner takes from begin, thieves take from end.
+    struct JobQueue
+    {
+        std::mutex lock;
+        int begin = 0;
+        int end = 0;
+
+        bool pop_front(int& k);
+        bool pop_back(int& k);
+        int size();
+    };
+
+    bool steal(int self, int& k);
+    void work(int self);
+    void loop(int self);
+
+    std::vector<JobQueue> queues;
+    std::vector<std::thread> threads;    // workers 1 to size() - 1
+
+    std::mutex lock;
+    std::condition_variable wake, idle;
+    const std::function<void(int, int)>* job = nullptr;
+    long long generation = 0;    // runs started
+    int busy = 0;                // workers still on the current run
+    bool stop = false;
+};
+
+// Runs job(k) for every k in [0, njobs) on a pool of nthreads threads
+// that lives for this one call. Code that runs many short loops in a row
+// should keep a ThreadPool instead.
+void parallel_for(int njobs, int nthreads,
+                  const std::function<void(int job, int worker)>& job);
+
+// number of hardware threads, at least 1
+int hardware_threads();
+
+#endif
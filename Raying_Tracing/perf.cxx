@@ -0,0 +1,90 @@
+#include "perf.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int open_counter(unsigned type, unsigned long long config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;          // also count threads started later on
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+unsigned long long cache_miss(unsigned cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+}
+
+PerfCounters::PerfCounters()
+{
+    fd[L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D));
+    fd[LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+    fd[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int c = 0; c < COUNT; c++)
+        if (fd[c] >= 0) close(fd[c]);
+}
+
+void PerfCounters::start()
+{
+    for (int c = 0; c < COUNT; c++) {
+        if (fd[c] < 0) continue;
+        ioctl(fd[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int c = 0; c < COUNT; c++)
+        if (fd[c] >= 0) ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+long long PerfCounters::value(Counter c) const
+{
+    long long v;
+    if (fd[c] < 0 || read(fd[c], &v, sizeof v) != (ssize_t) sizeof v) return -1;
+    return v;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    for (int c = 0; c < COUNT; c++)
+        fd[c] = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+long long PerfCounters::value(Counter) const { return -1; }
+
+#endif
+
+const char* PerfCounters::name(Counter c)
+{
+    switch (c) {
+    case L1D_MISSES: return "l1d_misses";
+    case LLC_MISSES: return "llc_misses";
+    default: return "instructions";
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Hardware cache miss counters of this process and of the threads it
+// starts while they are open, read through Linux perf_event_open(2).
+//
+// Where there are no counters to be had (not Linux, no PMU in a virtual
+// machine, perf_event_paranoid too strict) a counter is simply missing:
+// its value is -1 and the benchmark reports null for it.
+class PerfCounters
+{
+public:
+    enum Counter { L1D_MISSES, LLC_MISSES, INSTRUCTIONS, COUNT };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool available(Counter c) const { return fd[c] >= 0; }
+
+    // zero and start every available counter
+    void start();
+    // stop them; threads started in between must have been joined
+    void stop();
+
+    // count between the last start() and stop(), -1 if not available
+    long long value(Counter c) const;
+
+    static const char* name(Counter c);
+
+private:
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+    int fd[COUNT];
+};
+
+#endif
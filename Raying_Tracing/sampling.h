@@ -0,0 +1,29 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cstdint>
+
+// Small, fast random number generator (splitmix64).
+// Seeded from the pixel (and pass) being rendered, so the random numbers
+// a pixel sees do not depend on which thread renders it or when.
+struct Rng
+{
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed) {}
+    Rng(int i, int j, int pass = 0)
+        : state(((uint64_t) (uint32_t) j << 32 | (uint32_t) i) * 0x9e3779b97f4a7c15ull + (uint64_t) pass) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "scene.h"
+
+#include <random>
+#include <algorithm>
+
+std::vector<Sphere> random_spheres(int n, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> x(-1500, 1500);
+    std::uniform_real_distribution<double> y(-1500, 1500);
+    std::uniform_real_distribution<double> z(-2500, -600);
+    std::uniform_real_distribution<double> shade(0.3, 1.0);
+
+    // keep the total volume roughly constant as n grows
+    double r = 900.0 / std::cbrt((double) n);
+
+    std::vector<Sphere> s;
+    s.reserve(n);
+    for (int i = 0; i < n; i++) {
+        vec3 p(x(gen), y(gen), z(gen));
+        vec3 c(shade(gen), shade(gen), shade(gen));
+        s.push_back(Sphere(r, p, vec3(), c, DIFF));
+    }
+    return s;
+}
+
+void tessellate(const std::vector<Sphere>& spheres, int segments, Mesh& mesh)
+{
+    const double PI = 3.14159265358979323846;
+    segments = std::max(4, segments);
+    int rings = segments / 2;
+
+    for (auto& s : spheres) {
+        uint32_t first = (uint32_t) mesh.vertices.size();
+        // poles, then rings - 1 circles of segments vertices from the top
+        mesh.vertices.push_back(s.p + vec3(0, s.r, 0));
+        mesh.vertices.push_back(s.p - vec3(0, s.r, 0));
+        for (int r = 1; r < rings; r++) {
+            double theta = PI * r / rings;
+            for (int k = 0; k < segments; k++) {
+                double phi = 2 * PI * k / segments;
+                vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                mesh.vertices.push_back(s.p + s.r * d);
+            }
+        }
+        mesh.colors.resize(mesh.vertices.size(), s.c);
+
+        auto at = [&](int r, int k) { return first + 2 + (uint32_t) ((r - 1) * segments + k % segments); };
+        auto tri = [&](uint32_t a, uint32_t b, uint32_t c) {
+            mesh.indices.push_back(a);
+            mesh.indices.push_back(b);
+            mesh.indices.push_back(c);
+        };
+        for (int k = 0; k < segments; k++) {
+            tri(first, at(1, k + 1), at(1, k));
+            tri(first + 1, at(rings - 1, k), at(rings - 1, k + 1));
+            for (int r = 1; r < rings - 1; r++) {
+                tri(at(r, k), at(r, k + 1), at(r + 1, k));
+                tri(at(r, k + 1), at(r + 1, k + 1), at(r + 1, k));
+            }
+        }
+    }
+}
+
+void fit_mesh(Mesh& mesh, const vec3& center, double size)
+{
+    if (mesh.vertices.empty()) return;
+    vec3 lo = mesh.vertices[0], hi = lo;
+    for (auto& v : mesh.vertices) {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+    vec3 ext = hi - lo;
+    double longest = std::max(ext[0], std::max(ext[1], ext[2]));
+    double scale = longest > 0 ? size / longest : 1;
+    vec3 mid = (lo + hi) * 0.5;
+    for (auto& v : mesh.vertices)
+        v = center + (v - mid) * scale;
+}
@@ -0,0 +1,173 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Everything the tracer computes with is a template on the scalar type T
+// (float or double); the plain names below are the double versions.
+
+template <typename T>
+struct RayT
+{
+    typedef glm::tvec3<T> vec;
+
+    // origin and direction of this ray
+    vec o, d;
+
+    // arg d should always be normalized vector
+    RayT (vec o, vec d) : o(o), d(d) {}
+
+    template <typename U>
+    explicit RayT (const RayT<U>& r) : o(r.o), d(r.d) {}
+};
+
+// types of the surface
+// - DIFFuse, SPECular, REREective
+enum Refl_t { DIFF, SPEC, REFR };
+
+// Per scalar type constants.
+// eps is the smallest distance a hit may have from the ray origin; it
+// keeps a secondary ray from hitting the surface it starts on, so it has
+// to cover the rounding error of a hit point. With scenes a few thousand
+// units across, that error is ~1e-12 in double but ~1e-4 in float.
+template <typename T> struct Precision;
+
+template <> struct Precision<double>
+{
+    static constexpr double eps = 1e-4;
+    static const char* name() { return "double"; }
+};
+
+template <> struct Precision<float>
+{
+    static constexpr float eps = 1e-2f;
+    static const char* name() { return "float"; }
+};
+
+template <typename T>
+struct SphereT
+{
+    typedef glm::tvec3<T> vec;
+
+    T r;           // radius
+    vec p;         // position (center)
+    vec e;         // emission
+    vec c;         // color
+    Refl_t refl;   // reflection type (DIFFuse, SPECular, REFRactive)
+
+    SphereT(T r, vec p, vec e, vec c, Refl_t refl)
+        : r{r}, p{p}, e{e}, c{c}, refl{refl} {}
+
+    template <typename U>
+    explicit SphereT(const SphereT<U>& s)
+        : r(T(s.r)), p(s.p), e(s.e), c(s.c), refl(s.refl) {}
+
+    T intersect(const RayT<T>& ray) const
+    {
+        // intersects with t > eps, return t
+        // otherwise, return 0
+        //
+        // ray.d is unit length, so with op = o - p the quadratic
+        // t^2 + 2 t (op.d) + op.op - r^2 = 0 needs no a term. Its
+        // discriminant b^2 - (op.op - r^2) is taken as r^2 - |op - b d|^2,
+        // the same value without the cancellation of two large terms,
+        // which matters in float far from the sphere
+
+        const T eps = Precision<T>::eps;
+        vec op = ray.o - p;
+        T b = glm::dot(op, ray.d);
+        vec l = op - b * ray.d;
+        T disc = (r * r) - glm::dot(l, l);
+        if (disc < 0) return 0;
+
+        T s = std::sqrt(disc);
+        T t = -b - s;
+        if (t > eps) return t;
+        t = -b + s;
+        if (t > eps) return t;
+        return 0;
+    }
+
+
+    vec normal(const vec& v) const
+    {
+	return glm::normalize(v - p);
+    }
+};
+
+// Indexed triangle mesh: every vertex is stored once, with its color,
+// and a triangle is three 32-bit indices into the vertices. Triangles are
+// flat shaded with their geometric normal and the mean color of their
+// vertices, and they are two-sided.
+template <typename T>
+struct MeshT
+{
+    typedef glm::tvec3<T> vec;
+
+    std::vector<vec> vertices;
+    std::vector<vec> colors;        // one per vertex
+    std::vector<uint32_t> indices;  // three per triangle
+
+    MeshT() {}
+
+    template <typename U>
+    explicit MeshT(const MeshT<U>& m) : indices(m.indices)
+    {
+        for (auto& v : m.vertices)
+            vertices.push_back(vec(v));
+        for (auto& c : m.colors)
+            colors.push_back(vec(c));
+    }
+
+    size_t triangles() const { return indices.size() / 3; }
+
+    const vec& vertex(size_t tri, int k) const { return vertices[indices[3 * tri + k]]; }
+
+    vec color(size_t tri) const
+    {
+        const uint32_t* v = &indices[3 * tri];
+        return (colors[v[0]] + colors[v[1]] + colors[v[2]]) / T(3);
+    }
+
+    // unit normal of the triangle, on the side a ray with direction d
+    // comes from
+    vec normal(size_t tri, const vec& d) const
+    {
+        vec a = vertex(tri, 0);
+        vec n = glm::normalize(glm::cross(vertex(tri, 1) - a, vertex(tri, 2) - a));
+        return glm::dot(n, d) > 0 ? -n : n;
+    }
+
+    // bytes of vertex, color and index data
+    size_t bytes() const
+    {
+        return (vertices.size() + colors.size()) * sizeof(vec) + indices.size() * sizeof(uint32_t);
+    }
+};
+
+using vec3 = glm::dvec3;
+typedef RayT<double> Ray;
+typedef SphereT<double> Sphere;
+typedef MeshT<double> Mesh;
+
+// small constant
+const double eps = Precision<double>::eps;
+
+// n small random spheres filling the view frustum behind the default
+// scene; always the same spheres for the same n and seed
+std::vector<Sphere> random_spheres(int n, unsigned seed = 457);
+
+// appends every sphere to mesh as a latitude-longitude sphere of
+// 2 * segments * (segments / 2 - 1) triangles in the sphere's color
+// (segments >= 4)
+void tessellate(const std::vector<Sphere>& spheres, int segments, Mesh& mesh);
+
+// scales and moves mesh so that its bounding box is centered on center
+// and its longest side is size
+void fit_mesh(Mesh& mesh, const vec3& center, double size);
+
+#endif
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "scene_file.h"
+
+using namespace std;
+
+// converts a text scene (see scene_file.h) into the binary format the
+// tracer maps with --scene, or writes a random scene of n spheres
+int main(int argc, char* argv[])
+{
+    vector<Sphere> spheres;
+    vec3 eye(0, 0, 200), light(0, 0, 200);
+    string err;
+
+    if (argc == 4 && string(argv[1]) == "--random") {
+        spheres = random_spheres(std::stoi(argv[2], nullptr));
+    }
+    else if (argc == 3) {
+        ifstream in(argv[1]);
+        if (!in) {
+            cerr << "scene_convert: cannot open input file " << argv[1] << endl;
+            exit(1);
+        }
+        if (!read_scene_text(in, spheres, eye, light, err)) {
+            cerr << "scene_convert: " << argv[1] << ": " << err << endl;
+            exit(1);
+        }
+    }
+    else {
+        cerr << "Usage:  scene_convert scene.txt scene.rts\n"
+             << "        scene_convert --random N scene.rts\n";
+        exit(1);
+    }
+
+    string out = argv[argc - 1];
+    if (!write_scene_file(out, spheres, eye, light, err)) {
+        cerr << "scene_convert: " << err << endl;
+        exit(1);
+    }
+    cerr << "scene_convert: wrote " << spheres.size() << " spheres to " << out << endl;
+
+    return 0;
+}
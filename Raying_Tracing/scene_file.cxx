@@ -0,0 +1,283 @@
+#include "scene_file.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t align_up(uint64_t v)
+{
+    return (v + SCENE_ALIGN - 1) / SCENE_ALIGN * SCENE_ALIGN;
+}
+
+// bytes per sphere in section s
+uint64_t element_size(int s)
+{
+    return s == SEC_REFL ? 1 : sizeof(double);
+}
+
+// section layout for count spheres, returns the file size
+uint64_t layout(uint64_t count, uint64_t offset[SEC_COUNT])
+{
+    uint64_t at = align_up(sizeof(SceneHeader));
+    for (int s = 0; s < SEC_COUNT; s++) {
+        offset[s] = at;
+        at = align_up(at + count * element_size(s));
+    }
+    return at;
+}
+
+}
+
+bool SceneFile::open(const std::string& path, std::string& err)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SceneHeader)) {
+        ::close(fd);
+        err = path + " is not a scene file (too short)";
+        return false;
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        err = "cannot map " + path;
+        return false;
+    }
+    base = (const uint8_t*) p;
+    length = st.st_size;
+
+    const SceneHeader& h = header();
+    uint64_t expect[SEC_COUNT];
+    if (memcmp(h.magic, SCENE_MAGIC, sizeof(h.magic)) != 0)
+        err = path + " is not a scene file (bad magic, text scenes need scene_convert first)";
+    else if (h.version != SCENE_VERSION)
+        err = path + ": unsupported scene version " + std::to_string(h.version);
+    else if (h.byte_order != SCENE_BYTE_ORDER)
+        err = path + " was written on a machine with a different byte order";
+    else if (h.count > (uint64_t) INT32_MAX)
+        err = path + " has a broken sphere count";
+    else if (layout(h.count, expect) > length || memcmp(expect, h.offset, sizeof(expect)) != 0)
+        err = path + " is truncated or has a broken section table";
+    else {
+        // the path tracer indexes tables by material
+        const uint8_t* refl = this->refl();
+        for (uint64_t i = 0; i < h.count; i++) {
+            if (refl[i] > REFR) {
+                err = path + " has an unknown material (refl " + std::to_string(refl[i]) + ")";
+                close();
+                return false;
+            }
+        }
+        // the arrays are read front to back when the scene is built
+        madvise((void*) base, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    close();
+    return false;
+}
+
+void SceneFile::close()
+{
+    if (base) munmap((void*) base, length);
+    base = nullptr;
+    length = 0;
+}
+
+void SceneFile::spheres(std::vector<Sphere>& out) const
+{
+    size_t n = count();
+    const double *cx = array(SEC_CX), *cy = array(SEC_CY), *cz = array(SEC_CZ), *r = array(SEC_R);
+    const double *er = array(SEC_ER), *eg = array(SEC_EG), *eb = array(SEC_EB);
+    const double *cr = array(SEC_CR), *cg = array(SEC_CG), *cb = array(SEC_CB);
+    const uint8_t* refl = this->refl();
+
+    out.clear();
+    out.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        out.push_back(Sphere(r[i], vec3(cx[i], cy[i], cz[i]), vec3(er[i], eg[i], eb[i]),
+                             vec3(cr[i], cg[i], cb[i]), (Refl_t) refl[i]));
+    }
+}
+
+bool write_scene_file(const std::string& path, const std::vector<Sphere>& spheres,
+                      const vec3& eye, const vec3& light, std::string& err)
+{
+    SceneHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SCENE_MAGIC, sizeof(h.magic));
+    h.version = SCENE_VERSION;
+    h.byte_order = SCENE_BYTE_ORDER;
+    h.count = spheres.size();
+    for (int a = 0; a < 3; a++) {
+        h.eye[a] = eye[a];
+        h.light[a] = light[a];
+    }
+    uint64_t size = layout(h.count, h.offset);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        err = "cannot create " + path;
+        return false;
+    }
+
+    // writes one section, padded up to the next one
+    uint64_t at = 0;
+    auto put = [&](const void* data, uint64_t bytes, uint64_t next) {
+        out.write((const char*) data, bytes);
+        static const char zeros[SCENE_ALIGN] = {0};
+        out.write(zeros, next - at - bytes);
+        at = next;
+    };
+    put(&h, sizeof(h), h.offset[0]);
+
+    std::vector<double> column(spheres.size());
+    for (int s = 0; s < SEC_REFL; s++) {
+        for (size_t i = 0; i < spheres.size(); i++) {
+            const Sphere& sp = spheres[i];
+            switch (s) {
+            case SEC_CX: column[i] = sp.p[0]; break;
+            case SEC_CY: column[i] = sp.p[1]; break;
+            case SEC_CZ: column[i] = sp.p[2]; break;
+            case SEC_R:  column[i] = sp.r; break;
+            case SEC_ER: column[i] = sp.e[0]; break;
+            case SEC_EG: column[i] = sp.e[1]; break;
+            case SEC_EB: column[i] = sp.e[2]; break;
+            case SEC_CR: column[i] = sp.c[0]; break;
+            case SEC_CG: column[i] = sp.c[1]; break;
+            case SEC_CB: column[i] = sp.c[2]; break;
+            }
+        }
+        put(column.data(), column.size() * sizeof(double), h.offset[s + 1]);
+    }
+
+    std::vector<uint8_t> refl(spheres.size());
+    for (size_t i = 0; i < spheres.size(); i++)
+        refl[i] = (uint8_t) spheres[i].refl;
+    put(refl.data(), refl.size(), size);
+
+    if (!out) {
+        err = "error writing " + path;
+        return false;
+    }
+    return true;
+}
+
+bool read_scene_text(std::istream& in, std::vector<Sphere>& spheres,
+                     vec3& eye, vec3& light, std::string& err)
+{
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream ls(line);
+        std::string what;
+        if (!(ls >> what)) continue;
+
+        bool ok;
+        if (what == "eye") {
+            ok = (bool) (ls >> eye[0] >> eye[1] >> eye[2]);
+        }
+        else if (what == "light") {
+            ok = (bool) (ls >> light[0] >> light[1] >> light[2]);
+        }
+        else if (what == "sphere") {
+            double r;
+            vec3 p, e, c;
+            std::string refl;
+            ok = (bool) (ls >> r >> p[0] >> p[1] >> p[2] >> e[0] >> e[1] >> e[2]
+                            >> c[0] >> c[1] >> c[2] >> refl);
+            Refl_t t = DIFF;
+            if (refl == "SPEC") t = SPEC;
+            else if (refl == "REFR") t = REFR;
+            else if (refl != "DIFF") ok = false;
+            if (ok) spheres.push_back(Sphere(r, p, e, c, t));
+        }
+        else {
+            ok = false;
+        }
+
+        std::string extra;
+        if (!ok || ls >> extra) {
+            err = "line " + std::to_string(lineno) + ": cannot parse '" + line + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_mesh_obj(std::istream& in, Mesh& mesh, std::string& err)
+{
+    const size_t first = mesh.vertices.size();
+    std::vector<uint32_t> face;
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream ls(line);
+        std::string what;
+        if (!(ls >> what)) continue;
+
+        bool ok = true;
+        if (what == "v") {
+            vec3 p;
+            std::vector<double> c;
+            double x;
+            ok = (bool) (ls >> p[0] >> p[1] >> p[2]);
+            while (ok && ls >> x)
+                c.push_back(x);
+            ok = ok && ls.eof() && (c.empty() || c.size() == 3);
+            if (ok) {
+                mesh.vertices.push_back(p);
+                mesh.colors.push_back(c.empty() ? vec3(.8, .8, .8) : vec3(c[0], c[1], c[2]));
+            }
+        }
+        else if (what == "f") {
+            // v, v/vt, v//vn or v/vt/vn; only v is used
+            face.clear();
+            std::string item;
+            size_t count = mesh.vertices.size() - first;
+            while (ok && ls >> item) {
+                long v = atol(item.c_str());
+                if (v < 0) v += (long) count + 1;
+                ok = v >= 1 && v <= (long) count;
+                if (ok) face.push_back((uint32_t) (first + v - 1));
+            }
+            ok = ok && face.size() >= 3;
+            for (size_t k = 2; ok && k < face.size(); k++) {
+                mesh.indices.push_back(face[0]);
+                mesh.indices.push_back(face[k - 1]);
+                mesh.indices.push_back(face[k]);
+            }
+        }
+        else if (what == "vt" || what == "vn" || what == "vp" || what == "o" || what == "g" ||
+                 what == "s" || what == "usemtl" || what == "mtllib" || what == "l") {
+            continue;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            err = "line " + std::to_string(lineno) + ": cannot parse '" + line + "'";
+            return false;
+        }
+    }
+    return true;
+}
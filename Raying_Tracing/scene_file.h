@@ -0,0 +1,98 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "scene.h"
+
+// Binary scene file (.rts)
+//
+//   header    SceneHeader, at offset 0
+//   sections  one array per sphere attribute (structure of arrays), each
+//             starting on a SCENE_ALIGN byte boundary: doubles for the
+//             geometry, emission and color, one byte per sphere for refl
+//
+// Everything is stored in the byte order of the machine that wrote it;
+// byte_order tells the loader whether that matches its own.
+
+const char SCENE_MAGIC[8] = "RTSCENE";
+const uint32_t SCENE_VERSION = 1;
+const uint32_t SCENE_BYTE_ORDER = 0x01020304;
+const uint64_t SCENE_ALIGN = 64;
+
+enum SceneSection {
+    SEC_CX, SEC_CY, SEC_CZ, SEC_R,      // center and radius
+    SEC_ER, SEC_EG, SEC_EB,             // emission
+    SEC_CR, SEC_CG, SEC_CB,             // color
+    SEC_REFL,                           // Refl_t, one byte each
+    SEC_COUNT
+};
+
+struct SceneHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;                 // number of spheres
+    double eye[3];
+    double light[3];
+    uint64_t offset[SEC_COUNT];     // file offset of each section
+};
+
+// A scene file mapped into memory. Opening it reads the header and the
+// refl section, to check every material is known; the other pages are
+// faulted in as the arrays are touched. The tracer does not trace the
+// arrays in place: spheres() copies them into its sphere list, and the
+// BVH then reorders the spheres into leaf blocks of its own.
+class SceneFile
+{
+public:
+    SceneFile() : base(nullptr), length(0) {}
+    ~SceneFile() { close(); }
+
+    // maps path and checks the header and section bounds,
+    // on failure returns false with the reason in err
+    bool open(const std::string& path, std::string& err);
+    void close();
+
+    const SceneHeader& header() const { return *(const SceneHeader*) base; }
+    size_t count() const { return header().count; }
+
+    const double* array(SceneSection s) const { return (const double*) (base + header().offset[s]); }
+    const uint8_t* refl() const { return base + header().offset[SEC_REFL]; }
+
+    // builds the tracer's sphere list from the mapped arrays, in one pass
+    // without any parsing
+    void spheres(std::vector<Sphere>& out) const;
+
+private:
+    SceneFile(const SceneFile&);
+    SceneFile& operator=(const SceneFile&);
+
+    const uint8_t* base;
+    size_t length;
+};
+
+// writes spheres, eye and light as a binary scene file
+bool write_scene_file(const std::string& path, const std::vector<Sphere>& spheres,
+                      const vec3& eye, const vec3& light, std::string& err);
+
+// Reads the text scene format, one item per line, # starts a comment:
+//   eye x y z
+//   light x y z
+//   sphere r  px py pz  er eg eb  cr cg cb  DIFF|SPEC|REFR
+// eye and light keep their value unless the text sets them.
+bool read_scene_text(std::istream& in, std::vector<Sphere>& spheres,
+                     vec3& eye, vec3& light, std::string& err);
+
+// Reads the vertices and faces of a Wavefront OBJ file and appends them
+// to mesh:
+//   v x y z [r g b]     vertex, with an optional color (default .8 gray)
+//   f v1 v2 v3 ...      face; v/vt/vn forms and negative (relative)
+//                       indices are accepted, polygons are split into a fan
+// Texture coordinates, normals, groups and materials are skipped.
+bool read_mesh_obj(std::istream& in, Mesh& mesh, std::string& err);
+
+#endif
@@ -0,0 +1,418 @@
+#include "soa.h"
+
+#include <limits>
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// All kernels evaluate the same expressions in the same order as
+// SphereT<T>::intersect(), without fused multiply-adds, so every kernel
+// returns bit-identical distances for a given T.
+
+namespace {
+
+// closest of the n lane distances below tmax, lowest lane on ties
+template <typename T>
+inline int closest_lane(const T* tl, int n, T tmax, T& t)
+{
+    int lane = -1;
+    for (int l = 0; l < n; l++) {
+        if (tl[l] < tmax) {
+            tmax = tl[l];
+            lane = l;
+        }
+    }
+    if (lane >= 0) t = tmax;
+    return lane;
+}
+
+template <typename T>
+int intersect_scalar(const SphereSoAT<T>& soa, size_t k, const RayT<T>& ray, T tmax, T& t)
+{
+    const int N = SphereSoAT<T>::BLOCK;
+    const T eps = Precision<T>::eps;
+    T tl[N];
+    for (int l = 0; l < N; l++) {
+        T ox = ray.o[0] - soa.cx[k + l];
+        T oy = ray.o[1] - soa.cy[k + l];
+        T oz = ray.o[2] - soa.cz[k + l];
+        T b = ox * ray.d[0] + oy * ray.d[1] + oz * ray.d[2];
+        // r^2 - |op - b d|^2 rather than b^2 - c, see SphereT::intersect()
+        T lx = ox - b * ray.d[0], ly = oy - b * ray.d[1], lz = oz - b * ray.d[2];
+        T disc = soa.r2[k + l] - (lx * lx + ly * ly + lz * lz);
+        tl[l] = std::numeric_limits<T>::infinity();
+        if (disc < 0) continue;
+        T s = std::sqrt(disc);
+        T t0 = -b - s, t1 = -b + s;
+        if (t0 > eps) tl[l] = t0;
+        else if (t1 > eps) tl[l] = t1;
+    }
+    return closest_lane(tl, N, tmax, t);
+}
+
+// The ray in the sheared space of the watertight triangle test: kz is the
+// axis the direction is longest along, kx and ky the other two in an
+// order that keeps the winding, and the shear by sx, sy, sz maps the
+// direction to (0, 0, 1).
+template <typename T>
+struct Shear
+{
+    int kx, ky, kz;
+    T sx, sy, sz;
+
+    explicit Shear(const RayT<T>& ray)
+    {
+        T ad[3] = {std::abs(ray.d[0]), std::abs(ray.d[1]), std::abs(ray.d[2])};
+        kz = ad[0] > ad[1] ? (ad[0] > ad[2] ? 0 : 2) : (ad[1] > ad[2] ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        if (ray.d[kz] < 0) std::swap(kx, ky);
+        sx = ray.d[kx] / ray.d[kz];
+        sy = ray.d[ky] / ray.d[kz];
+        sz = 1 / ray.d[kz];
+    }
+};
+
+// Edge functions u, v, w of the sheared 2D vertices. In float, one that
+// rounds to exactly 0 is computed again in double, where the products
+// of two floats are exact: 0 decides whether a ray on an edge hits, so it
+// has to be right. All three 0 is a degenerate triangle (or padding).
+inline void refine_edges(double, double, double, double, double, double, double&, double&, double&) {}
+
+inline void refine_edges(float ax, float ay, float bx, float by, float cx, float cy,
+                         float& u, float& v, float& w)
+{
+    if ((u != 0 && v != 0 && w != 0) || (u == 0 && v == 0 && w == 0)) return;
+    u = (float) ((double) cx * by - (double) cy * bx);
+    v = (float) ((double) ax * cy - (double) ay * cx);
+    w = (float) ((double) bx * ay - (double) by * ax);
+}
+
+template <typename T>
+int triangles_scalar(const TriangleSoAT<T>& soa, size_t k, const RayT<T>& ray, T tmax, T& t)
+{
+    const int N = TriangleSoAT<T>::BLOCK;
+    const T eps = Precision<T>::eps;
+    const Shear<T> s(ray);
+    const T ox = ray.o[s.kx], oy = ray.o[s.ky], oz = ray.o[s.kz];
+    T tl[N];
+    for (int l = 0; l < N; l++) {
+        size_t i = k + l;
+        T az = soa.a[s.kz][i] - oz, bz = soa.b[s.kz][i] - oz, cz = soa.c[s.kz][i] - oz;
+        T ax = (soa.a[s.kx][i] - ox) - s.sx * az, ay = (soa.a[s.ky][i] - oy) - s.sy * az;
+        T bx = (soa.b[s.kx][i] - ox) - s.sx * bz, by = (soa.b[s.ky][i] - oy) - s.sy * bz;
+        T cx = (soa.c[s.kx][i] - ox) - s.sx * cz, cy = (soa.c[s.ky][i] - oy) - s.sy * cz;
+        T u = cx * by - cy * bx;
+        T v = ax * cy - ay * cx;
+        T w = bx * ay - by * ax;
+        refine_edges(ax, ay, bx, by, cx, cy, u, v, w);
+
+        tl[l] = std::numeric_limits<T>::infinity();
+        // the ray passes outside unless all three have the same sign
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) continue;
+        T det = u + v + w;
+        if (det == 0) continue;
+        T tn = u * (s.sz * az) + v * (s.sz * bz) + w * (s.sz * cz);
+        T th = tn / det;
+        if (th > eps) tl[l] = th;
+    }
+    return closest_lane(tl, N, tmax, t);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+const double INF = std::numeric_limits<double>::infinity();
+const float INFF = std::numeric_limits<float>::infinity();
+
+// double, 2 lanes per SSE register
+__attribute__((target("sse2")))
+void lanes_sse2(const double* cx, const double* cy, const double* cz, const double* r2,
+                const Ray& ray, double* tl)
+{
+    const __m128d ox = _mm_set1_pd(ray.o[0]), oy = _mm_set1_pd(ray.o[1]), oz = _mm_set1_pd(ray.o[2]);
+    const __m128d dx = _mm_set1_pd(ray.d[0]), dy = _mm_set1_pd(ray.d[1]), dz = _mm_set1_pd(ray.d[2]);
+    const __m128d veps = _mm_set1_pd(eps), vinf = _mm_set1_pd(INF), zero = _mm_setzero_pd();
+
+    __m128d px = _mm_sub_pd(ox, _mm_loadu_pd(cx));
+    __m128d py = _mm_sub_pd(oy, _mm_loadu_pd(cy));
+    __m128d pz = _mm_sub_pd(oz, _mm_loadu_pd(cz));
+    __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(px, dx), _mm_mul_pd(py, dy)), _mm_mul_pd(pz, dz));
+    __m128d lx = _mm_sub_pd(px, _mm_mul_pd(b, dx));
+    __m128d ly = _mm_sub_pd(py, _mm_mul_pd(b, dy));
+    __m128d lz = _mm_sub_pd(pz, _mm_mul_pd(b, dz));
+    __m128d disc = _mm_sub_pd(_mm_loadu_pd(r2),
+                              _mm_add_pd(_mm_add_pd(_mm_mul_pd(lx, lx), _mm_mul_pd(ly, ly)), _mm_mul_pd(lz, lz)));
+    __m128d valid = _mm_cmpge_pd(disc, zero);
+    __m128d s = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+    __m128d nb = _mm_sub_pd(zero, b);
+    __m128d t0 = _mm_sub_pd(nb, s), t1 = _mm_add_pd(nb, s);
+
+    // t0 if it is in front of the origin, else t1, else miss
+    __m128d m0 = _mm_cmpgt_pd(t0, veps), m1 = _mm_cmpgt_pd(t1, veps);
+    __m128d r = _mm_or_pd(_mm_and_pd(m1, t1), _mm_andnot_pd(m1, vinf));
+    r = _mm_or_pd(_mm_and_pd(m0, t0), _mm_andnot_pd(m0, r));
+    r = _mm_or_pd(_mm_and_pd(valid, r), _mm_andnot_pd(valid, vinf));
+    _mm_storeu_pd(tl, r);
+}
+
+int intersect_sse2(const SphereSoA& soa, size_t k, const Ray& ray, double tmax, double& t)
+{
+    double tl[4];
+    lanes_sse2(&soa.cx[k], &soa.cy[k], &soa.cz[k], &soa.r2[k], ray, tl);
+    lanes_sse2(&soa.cx[k + 2], &soa.cy[k + 2], &soa.cz[k + 2], &soa.r2[k + 2], ray, tl + 2);
+    return closest_lane(tl, 4, tmax, t);
+}
+
+// double, 4 lanes per AVX register
+__attribute__((target("avx2")))
+int intersect_avx2(const SphereSoA& soa, size_t k, const Ray& ray, double tmax, double& t)
+{
+    const __m256d ox = _mm256_set1_pd(ray.o[0]), oy = _mm256_set1_pd(ray.o[1]), oz = _mm256_set1_pd(ray.o[2]);
+    const __m256d dx = _mm256_set1_pd(ray.d[0]), dy = _mm256_set1_pd(ray.d[1]), dz = _mm256_set1_pd(ray.d[2]);
+    const __m256d veps = _mm256_set1_pd(eps), vinf = _mm256_set1_pd(INF), zero = _mm256_setzero_pd();
+
+    __m256d px = _mm256_sub_pd(ox, _mm256_loadu_pd(&soa.cx[k]));
+    __m256d py = _mm256_sub_pd(oy, _mm256_loadu_pd(&soa.cy[k]));
+    __m256d pz = _mm256_sub_pd(oz, _mm256_loadu_pd(&soa.cz[k]));
+    __m256d b = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, dx), _mm256_mul_pd(py, dy)), _mm256_mul_pd(pz, dz));
+    __m256d lx = _mm256_sub_pd(px, _mm256_mul_pd(b, dx));
+    __m256d ly = _mm256_sub_pd(py, _mm256_mul_pd(b, dy));
+    __m256d lz = _mm256_sub_pd(pz, _mm256_mul_pd(b, dz));
+    __m256d disc = _mm256_sub_pd(_mm256_loadu_pd(&soa.r2[k]),
+                                 _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(lx, lx), _mm256_mul_pd(ly, ly)), _mm256_mul_pd(lz, lz)));
+    __m256d valid = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+    if (_mm256_movemask_pd(valid) == 0) return -1;
+
+    __m256d s = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+    __m256d nb = _mm256_sub_pd(zero, b);
+    __m256d t0 = _mm256_sub_pd(nb, s), t1 = _mm256_add_pd(nb, s);
+
+    __m256d r = _mm256_blendv_pd(vinf, t1, _mm256_cmp_pd(t1, veps, _CMP_GT_OQ));
+    r = _mm256_blendv_pd(r, t0, _mm256_cmp_pd(t0, veps, _CMP_GT_OQ));
+    r = _mm256_blendv_pd(vinf, r, valid);
+
+    // nothing closer than tmax: skip the horizontal reduction
+    if (_mm256_movemask_pd(_mm256_cmp_pd(r, _mm256_set1_pd(tmax), _CMP_LT_OQ)) == 0) return -1;
+
+    double tl[4];
+    _mm256_storeu_pd(tl, r);
+    return closest_lane(tl, 4, tmax, t);
+}
+
+// float, 4 lanes per SSE register
+__attribute__((target("sse2")))
+void lanes_sse2(const float* cx, const float* cy, const float* cz, const float* r2,
+                const RayT<float>& ray, float* tl)
+{
+    const __m128 ox = _mm_set1_ps(ray.o[0]), oy = _mm_set1_ps(ray.o[1]), oz = _mm_set1_ps(ray.o[2]);
+    const __m128 dx = _mm_set1_ps(ray.d[0]), dy = _mm_set1_ps(ray.d[1]), dz = _mm_set1_ps(ray.d[2]);
+    const __m128 veps = _mm_set1_ps(Precision<float>::eps), vinf = _mm_set1_ps(INFF), zero = _mm_setzero_ps();
+
+    __m128 px = _mm_sub_ps(ox, _mm_loadu_ps(cx));
+    __m128 py = _mm_sub_ps(oy, _mm_loadu_ps(cy));
+    __m128 pz = _mm_sub_ps(oz, _mm_loadu_ps(cz));
+    __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, dx), _mm_mul_ps(py, dy)), _mm_mul_ps(pz, dz));
+    __m128 lx = _mm_sub_ps(px, _mm_mul_ps(b, dx));
+    __m128 ly = _mm_sub_ps(py, _mm_mul_ps(b, dy));
+    __m128 lz = _mm_sub_ps(pz, _mm_mul_ps(b, dz));
+    __m128 disc = _mm_sub_ps(_mm_loadu_ps(r2),
+                             _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)));
+    __m128 valid = _mm_cmpge_ps(disc, zero);
+    __m128 s = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+    __m128 nb = _mm_sub_ps(zero, b);
+    __m128 t0 = _mm_sub_ps(nb, s), t1 = _mm_add_ps(nb, s);
+
+    __m128 m0 = _mm_cmpgt_ps(t0, veps), m1 = _mm_cmpgt_ps(t1, veps);
+    __m128 r = _mm_or_ps(_mm_and_ps(m1, t1), _mm_andnot_ps(m1, vinf));
+    r = _mm_or_ps(_mm_and_ps(m0, t0), _mm_andnot_ps(m0, r));
+    r = _mm_or_ps(_mm_and_ps(valid, r), _mm_andnot_ps(valid, vinf));
+    _mm_storeu_ps(tl, r);
+}
+
+int intersect_sse2(const SphereSoAT<float>& soa, size_t k, const RayT<float>& ray, float tmax, float& t)
+{
+    float tl[8];
+    lanes_sse2(&soa.cx[k], &soa.cy[k], &soa.cz[k], &soa.r2[k], ray, tl);
+    lanes_sse2(&soa.cx[k + 4], &soa.cy[k + 4], &soa.cz[k + 4], &soa.r2[k + 4], ray, tl + 4);
+    return closest_lane(tl, 8, tmax, t);
+}
+
+// float, 8 lanes per AVX register
+__attribute__((target("avx2")))
+int intersect_avx2(const SphereSoAT<float>& soa, size_t k, const RayT<float>& ray, float tmax, float& t)
+{
+    const __m256 ox = _mm256_set1_ps(ray.o[0]), oy = _mm256_set1_ps(ray.o[1]), oz = _mm256_set1_ps(ray.o[2]);
+    const __m256 dx = _mm256_set1_ps(ray.d[0]), dy = _mm256_set1_ps(ray.d[1]), dz = _mm256_set1_ps(ray.d[2]);
+    const __m256 veps = _mm256_set1_ps(Precision<float>::eps), vinf = _mm256_set1_ps(INFF);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 px = _mm256_sub_ps(ox, _mm256_loadu_ps(&soa.cx[k]));
+    __m256 py = _mm256_sub_ps(oy, _mm256_loadu_ps(&soa.cy[k]));
+    __m256 pz = _mm256_sub_ps(oz, _mm256_loadu_ps(&soa.cz[k]));
+    __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, dx), _mm256_mul_ps(py, dy)), _mm256_mul_ps(pz, dz));
+    __m256 lx = _mm256_sub_ps(px, _mm256_mul_ps(b, dx));
+    __m256 ly = _mm256_sub_ps(py, _mm256_mul_ps(b, dy));
+    __m256 lz = _mm256_sub_ps(pz, _mm256_mul_ps(b, dz));
+    __m256 disc = _mm256_sub_ps(_mm256_loadu_ps(&soa.r2[k]),
+                                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz)));
+    __m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+    if (_mm256_movemask_ps(valid) == 0) return -1;
+
+    __m256 s = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+    __m256 nb = _mm256_sub_ps(zero, b);
+    __m256 t0 = _mm256_sub_ps(nb, s), t1 = _mm256_add_ps(nb, s);
+
+    __m256 r = _mm256_blendv_ps(vinf, t1, _mm256_cmp_ps(t1, veps, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, t0, _mm256_cmp_ps(t0, veps, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(vinf, r, valid);
+
+    if (_mm256_movemask_ps(_mm256_cmp_ps(r, _mm256_set1_ps(tmax), _CMP_LT_OQ)) == 0) return -1;
+
+    float tl[8];
+    _mm256_storeu_ps(tl, r);
+    return closest_lane(tl, 8, tmax, t);
+}
+
+// triangles, double, 4 lanes per AVX register
+__attribute__((target("avx2")))
+int triangles_avx2(const TriangleSoA& soa, size_t k, const Ray& ray, double tmax, double& t)
+{
+    const Shear<double> s(ray);
+    const __m256d ox = _mm256_set1_pd(ray.o[s.kx]), oy = _mm256_set1_pd(ray.o[s.ky]), oz = _mm256_set1_pd(ray.o[s.kz]);
+    const __m256d sx = _mm256_set1_pd(s.sx), sy = _mm256_set1_pd(s.sy), sz = _mm256_set1_pd(s.sz);
+    const __m256d veps = _mm256_set1_pd(eps), vinf = _mm256_set1_pd(INF), zero = _mm256_setzero_pd();
+
+    __m256d az = _mm256_sub_pd(_mm256_loadu_pd(&soa.a[s.kz][k]), oz);
+    __m256d bz = _mm256_sub_pd(_mm256_loadu_pd(&soa.b[s.kz][k]), oz);
+    __m256d cz = _mm256_sub_pd(_mm256_loadu_pd(&soa.c[s.kz][k]), oz);
+    __m256d ax = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.a[s.kx][k]), ox), _mm256_mul_pd(sx, az));
+    __m256d ay = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.a[s.ky][k]), oy), _mm256_mul_pd(sy, az));
+    __m256d bx = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.b[s.kx][k]), ox), _mm256_mul_pd(sx, bz));
+    __m256d by = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.b[s.ky][k]), oy), _mm256_mul_pd(sy, bz));
+    __m256d cx = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.c[s.kx][k]), ox), _mm256_mul_pd(sx, cz));
+    __m256d cy = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(&soa.c[s.ky][k]), oy), _mm256_mul_pd(sy, cz));
+    __m256d u = _mm256_sub_pd(_mm256_mul_pd(cx, by), _mm256_mul_pd(cy, bx));
+    __m256d v = _mm256_sub_pd(_mm256_mul_pd(ax, cy), _mm256_mul_pd(ay, cx));
+    __m256d w = _mm256_sub_pd(_mm256_mul_pd(bx, ay), _mm256_mul_pd(by, ax));
+
+    __m256d neg = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(u, zero, _CMP_LT_OQ), _mm256_cmp_pd(v, zero, _CMP_LT_OQ)),
+                               _mm256_cmp_pd(w, zero, _CMP_LT_OQ));
+    __m256d pos = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(u, zero, _CMP_GT_OQ), _mm256_cmp_pd(v, zero, _CMP_GT_OQ)),
+                               _mm256_cmp_pd(w, zero, _CMP_GT_OQ));
+    __m256d det = _mm256_add_pd(_mm256_add_pd(u, v), w);
+    __m256d miss = _mm256_or_pd(_mm256_and_pd(neg, pos), _mm256_cmp_pd(det, zero, _CMP_EQ_OQ));
+    if (_mm256_movemask_pd(miss) == 0xf) return -1;
+
+    __m256d tn = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(u, _mm256_mul_pd(sz, az)), _mm256_mul_pd(v, _mm256_mul_pd(sz, bz))),
+                               _mm256_mul_pd(w, _mm256_mul_pd(sz, cz)));
+    __m256d th = _mm256_div_pd(tn, det);
+    __m256d r = _mm256_blendv_pd(vinf, th, _mm256_andnot_pd(miss, _mm256_cmp_pd(th, veps, _CMP_GT_OQ)));
+
+    if (_mm256_movemask_pd(_mm256_cmp_pd(r, _mm256_set1_pd(tmax), _CMP_LT_OQ)) == 0) return -1;
+
+    double tl[4];
+    _mm256_storeu_pd(tl, r);
+    return closest_lane(tl, 4, tmax, t);
+}
+
+// triangles, float, 8 lanes per AVX register
+__attribute__((target("avx2")))
+int triangles_avx2(const TriangleSoAT<float>& soa, size_t k, const RayT<float>& ray, float tmax, float& t)
+{
+    const Shear<float> s(ray);
+    const __m256 ox = _mm256_set1_ps(ray.o[s.kx]), oy = _mm256_set1_ps(ray.o[s.ky]), oz = _mm256_set1_ps(ray.o[s.kz]);
+    const __m256 sx = _mm256_set1_ps(s.sx), sy = _mm256_set1_ps(s.sy), sz = _mm256_set1_ps(s.sz);
+    const __m256 veps = _mm256_set1_ps(Precision<float>::eps), vinf = _mm256_set1_ps(INFF);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 az = _mm256_sub_ps(_mm256_loadu_ps(&soa.a[s.kz][k]), oz);
+    __m256 bz = _mm256_sub_ps(_mm256_loadu_ps(&soa.b[s.kz][k]), oz);
+    __m256 cz = _mm256_sub_ps(_mm256_loadu_ps(&soa.c[s.kz][k]), oz);
+    __m256 ax = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.a[s.kx][k]), ox), _mm256_mul_ps(sx, az));
+    __m256 ay = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.a[s.ky][k]), oy), _mm256_mul_ps(sy, az));
+    __m256 bx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.b[s.kx][k]), ox), _mm256_mul_ps(sx, bz));
+    __m256 by = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.b[s.ky][k]), oy), _mm256_mul_ps(sy, bz));
+    __m256 cx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.c[s.kx][k]), ox), _mm256_mul_ps(sx, cz));
+    __m256 cy = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&soa.c[s.ky][k]), oy), _mm256_mul_ps(sy, cz));
+    __m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+    __m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+    __m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+    // lanes with one or two edge functions of exactly 0 go through
+    // refine_edges(); all three 0 is padding, which is common
+    __m256 uz = _mm256_cmp_ps(u, zero, _CMP_EQ_OQ), vz = _mm256_cmp_ps(v, zero, _CMP_EQ_OQ);
+    __m256 wz = _mm256_cmp_ps(w, zero, _CMP_EQ_OQ);
+    __m256 any = _mm256_or_ps(_mm256_or_ps(uz, vz), wz), all = _mm256_and_ps(_mm256_and_ps(uz, vz), wz);
+    if (_mm256_movemask_ps(_mm256_andnot_ps(all, any)) != 0) {
+        float l[9][8];
+        __m256* lanes[9] = {&ax, &ay, &bx, &by, &cx, &cy, &u, &v, &w};
+        for (int x = 0; x < 9; x++)
+            _mm256_storeu_ps(l[x], *lanes[x]);
+        for (int i = 0; i < 8; i++)
+            refine_edges(l[0][i], l[1][i], l[2][i], l[3][i], l[4][i], l[5][i], l[6][i], l[7][i], l[8][i]);
+        u = _mm256_loadu_ps(l[6]);
+        v = _mm256_loadu_ps(l[7]);
+        w = _mm256_loadu_ps(l[8]);
+    }
+
+    __m256 neg = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(v, zero, _CMP_LT_OQ)),
+                              _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+    __m256 pos = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)),
+                              _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+    __m256 det = _mm256_add_ps(_mm256_add_ps(u, v), w);
+    __m256 miss = _mm256_or_ps(_mm256_and_ps(neg, pos), _mm256_cmp_ps(det, zero, _CMP_EQ_OQ));
+    if (_mm256_movemask_ps(miss) == 0xff) return -1;
+
+    __m256 tn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u, _mm256_mul_ps(sz, az)), _mm256_mul_ps(v, _mm256_mul_ps(sz, bz))),
+                              _mm256_mul_ps(w, _mm256_mul_ps(sz, cz)));
+    __m256 th = _mm256_div_ps(tn, det);
+    __m256 r = _mm256_blendv_ps(vinf, th, _mm256_andnot_ps(miss, _mm256_cmp_ps(th, veps, _CMP_GT_OQ)));
+
+    if (_mm256_movemask_ps(_mm256_cmp_ps(r, _mm256_set1_ps(tmax), _CMP_LT_OQ)) == 0) return -1;
+
+    float tl[8];
+    _mm256_storeu_ps(tl, r);
+    return closest_lane(tl, 8, tmax, t);
+}
+
+#endif
+
+}
+
+template <> SphereSoAT<double>::Kernel SphereSoAT<double>::intersect = intersect_scalar<double>;
+template <> SphereSoAT<float>::Kernel SphereSoAT<float>::intersect = intersect_scalar<float>;
+template <> TriangleSoAT<double>::Kernel TriangleSoAT<double>::intersect = triangles_scalar<double>;
+template <> TriangleSoAT<float>::Kernel TriangleSoAT<float>::intersect = triangles_scalar<float>;
+
+std::string select_kernel(const std::string& name)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool sse2 = __builtin_cpu_supports("sse2");
+
+    if ((name == "auto" || name == "avx2") && avx2) {
+        SphereSoAT<double>::intersect = intersect_avx2;
+        SphereSoAT<float>::intersect = intersect_avx2;
+        TriangleSoAT<double>::intersect = triangles_avx2;
+        TriangleSoAT<float>::intersect = triangles_avx2;
+        return "avx2";
+    }
+    if ((name == "auto" || name == "sse2") && sse2) {
+        SphereSoAT<double>::intersect = intersect_sse2;
+        SphereSoAT<float>::intersect = intersect_sse2;
+        TriangleSoAT<double>::intersect = triangles_scalar<double>;
+        TriangleSoAT<float>::intersect = triangles_scalar<float>;
+        return "sse2";
+    }
+#endif
+    if (name == "auto" || name == "scalar") {
+        SphereSoAT<double>::intersect = intersect_scalar<double>;
+        SphereSoAT<float>::intersect = intersect_scalar<float>;
+        TriangleSoAT<double>::intersect = triangles_scalar<double>;
+        TriangleSoAT<float>::intersect = triangles_scalar<float>;
+        return "scalar";
+    }
+    return "";
+}
@@ -0,0 +1,137 @@
+#ifndef SOA_H
+#define SOA_H
+
+#include <string>
+#include <vector>
+#include "scene.h"
+
+// Sphere geometry as structure of arrays, in blocks of one SIMD register
+// (4 doubles or 8 floats), so that one ray can be tested against a whole
+// block with one kernel call.
+// Unused slots hold r2 = -1, which can never be hit.
+template <typename T>
+struct SphereSoAT
+{
+    static const int BLOCK = 32 / sizeof(T);
+
+    // what the primitives come from (see BVHT::build())
+    typedef std::vector<SphereT<T>> Source;
+
+    // Tests ray against the BLOCK spheres of the block starting at k.
+    // Returns the lane of the closest hit with eps < t < tmax and stores
+    // its distance in t, or -1 if none of them is hit that close.
+    typedef int (*Kernel)(const SphereSoAT& soa, size_t k, const RayT<T>& ray, T tmax, T& t);
+
+    // the kernel in use, picked by select_kernel()
+    static Kernel intersect;
+
+    std::vector<T> cx, cy, cz, r2;
+
+    size_t size() const { return cx.size(); }
+    size_t bytes() const { return 4 * size() * sizeof(T); }
+
+    void clear()
+    {
+        cx.clear();
+        cy.clear();
+        cz.clear();
+        r2.clear();
+    }
+
+    void push(const SphereT<T>& s)
+    {
+        cx.push_back(s.p[0]);
+        cy.push_back(s.p[1]);
+        cz.push_back(s.p[2]);
+        r2.push_back(s.r * s.r);
+    }
+
+    // fill up the last block
+    void pad()
+    {
+        while (size() % BLOCK) {
+            cx.push_back(0);
+            cy.push_back(0);
+            cz.push_back(0);
+            r2.push_back(-1);
+        }
+    }
+};
+
+template <> SphereSoAT<double>::Kernel SphereSoAT<double>::intersect;
+template <> SphereSoAT<float>::Kernel SphereSoAT<float>::intersect;
+
+typedef SphereSoAT<double> SphereSoA;
+
+// Triangles of a mesh in the same blocks, the three vertices copied out of
+// the shared vertex buffer as one array per vertex and axis (a[0] holds x
+// of every first vertex), so any axis order can be loaded per ray.
+// Unused slots are degenerate triangles at the origin, which can never be
+// hit.
+//
+// The kernels use the watertight test of Woop, Benthin and Wald (2013):
+// the vertices are sheared into a space where the ray runs along +z from
+// the origin, and the hit is decided by the signs of the three 2D edge
+// functions. A ray through a shared edge or vertex always hits one of the
+// triangles around it, where Moller-Trumbore may miss both. The float
+// kernels redo edge functions that come out exactly 0 in double.
+template <typename T>
+struct TriangleSoAT
+{
+    static const int BLOCK = 32 / sizeof(T);
+
+    typedef MeshT<T> Source;
+
+    // same contract as SphereSoAT::Kernel; lane l is triangle k + l
+    typedef int (*Kernel)(const TriangleSoAT& soa, size_t k, const RayT<T>& ray, T tmax, T& t);
+
+    static Kernel intersect;
+
+    std::vector<T> a[3], b[3], c[3];
+
+    size_t size() const { return a[0].size(); }
+    size_t bytes() const { return 9 * size() * sizeof(T); }
+
+    void clear()
+    {
+        for (int x = 0; x < 3; x++) {
+            a[x].clear();
+            b[x].clear();
+            c[x].clear();
+        }
+    }
+
+    void push(const MeshT<T>& m, size_t tri)
+    {
+        for (int x = 0; x < 3; x++) {
+            a[x].push_back(m.vertex(tri, 0)[x]);
+            b[x].push_back(m.vertex(tri, 1)[x]);
+            c[x].push_back(m.vertex(tri, 2)[x]);
+        }
+    }
+
+    void pad()
+    {
+        while (size() % BLOCK) {
+            for (int x = 0; x < 3; x++) {
+                a[x].push_back(0);
+                b[x].push_back(0);
+                c[x].push_back(0);
+            }
+        }
+    }
+};
+
+template <> TriangleSoAT<double>::Kernel TriangleSoAT<double>::intersect;
+template <> TriangleSoAT<float>::Kernel TriangleSoAT<float>::intersect;
+
+typedef TriangleSoAT<double> TriangleSoA;
+
+// Picks the widest kernels the CPU supports ("auto"), or the named ones
+// ("scalar", "sse2", "avx2"), for both scalar types and both primitives.
+// There are no SSE2 triangle kernels; "sse2" tests triangles with the
+// scalar ones. Returns the name of the kernels selected, or an empty
+// string if the named ones are unknown or not supported.
+std::string select_kernel(const std::string& name = "auto");
+
+#endif
@@ -0,0 +1,265 @@
+#include "strips.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+bool write_full(int fd, const void* buf, size_t n)
+{
+    const char* p = (const char*) buf;
+    while (n > 0) {
+        ssize_t k = write(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+bool read_full(int fd, void* buf, size_t n)
+{
+    char* p = (char*) buf;
+    while (n > 0) {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+// CPUs of every NUMA node that has any, from sysfs ("0-3,8-11" lists)
+std::vector<std::vector<int>> numa_nodes()
+{
+    std::vector<std::vector<int>> nodes;
+    for (int n = 0;; n++) {
+        std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if (!f) break;
+        std::string list, range;
+        std::getline(f, list);
+        std::stringstream in(list);
+        std::vector<int> cpus;
+        while (std::getline(in, range, ',')) {
+            int lo, hi;
+            int k = sscanf(range.c_str(), "%d-%d", &lo, &hi);
+            if (k < 1) continue;
+            if (k == 1) hi = lo;
+            for (int c = lo; c <= hi; c++)
+                cpus.push_back(c);
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+// restricts the calling process to the CPUs of NUMA node worker % nodes;
+// memory it touches from then on is allocated on that node
+void pin_to_node(int worker)
+{
+    std::vector<std::vector<int>> nodes = numa_nodes();
+    if (nodes.empty()) {
+        std::cerr << "strips: no NUMA topology in /sys, worker " << worker << " not pinned" << std::endl;
+        return;
+    }
+    int node = worker % (int) nodes.size();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : nodes[node])
+        CPU_SET(c, &set);
+    if (sched_setaffinity(0, sizeof set, &set) != 0)
+        std::cerr << "strips: cannot pin worker " << worker << ": " << strerror(errno) << std::endl;
+    else
+        std::cerr << "strips: worker " << worker << " pinned to node " << node << std::endl;
+}
+
+// the worker side of the protocol, until asked to exit or the
+// coordinator goes away
+void worker_loop(int worker, int in, int out, int nx, const StripSettings& settings,
+                 const WorkerSetup& setup, const StripRenderer& render)
+{
+    if (settings.pin) pin_to_node(worker);
+    setup(worker);
+
+    std::vector<unsigned char> rgb;
+    StripRequest req;
+    while (read_full(in, &req, sizeof req) && req.magic == STRIP_MAGIC && req.rows > 0) {
+        rgb.resize((size_t) nx * req.rows * 3);
+        auto start = std::chrono::steady_clock::now();
+        long long samples = render(req.y0, req.rows, &rgb[0]);
+        StripReply rep;
+        rep.magic = STRIP_MAGIC;
+        rep.y0 = req.y0;
+        rep.rows = req.rows;
+        rep.nx = nx;
+        rep.samples = samples;
+        rep.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!write_full(out, &rep, sizeof rep) || !write_full(out, &rgb[0], rgb.size())) break;
+    }
+}
+
+// ignores SIGPIPE while it lives, so that a worker that died shows up as
+// a failed write instead of killing the coordinator; the old handler is
+// put back on the way out
+struct IgnoreSigpipe
+{
+    void (*old)(int);
+
+    IgnoreSigpipe() : old(signal(SIGPIPE, SIG_IGN)) {}
+    ~IgnoreSigpipe() { signal(SIGPIPE, old); }
+};
+
+struct Worker
+{
+    pid_t pid = -1;
+    int to = -1, from = -1;   // request and reply pipe ends
+    int strip = -1;           // strip being rendered, -1 if idle
+};
+
+void shut_down(std::vector<Worker>& workers, bool kill_them)
+{
+    for (auto& w : workers) {
+        if (w.to >= 0) close(w.to);
+        if (w.from >= 0) close(w.from);
+        w.to = w.from = -1;
+        if (w.pid > 0 && kill_them) kill(w.pid, SIGTERM);
+    }
+    for (auto& w : workers) {
+        if (w.pid > 0) waitpid(w.pid, nullptr, 0);
+        w.pid = -1;
+    }
+}
+
+}
+
+bool render_strips(int nx, int ny, const StripSettings& settings, unsigned char* rgb,
+                   const WorkerSetup& setup, const StripRenderer& render, const WorkersStarted& started,
+                   const RowsDone& done, StripStats& stats)
+{
+    int n = std::max(1, settings.processes);
+    int rows = settings.rows > 0 ? settings.rows : std::max(1, (ny + 4 * n - 1) / (4 * n));
+    int nstrips = (ny + rows - 1) / rows;
+
+    IgnoreSigpipe no_sigpipe;
+    std::cerr.flush();
+
+    std::vector<Worker> workers(n);
+    for (int w = 0; w < n; w++) {
+        int req[2], rep[2];
+        if (pipe(req) != 0 || pipe(rep) != 0) {
+            std::cerr << "strips: pipe: " << strerror(errno) << std::endl;
+            shut_down(workers, true);
+            return false;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(req[1]);
+            close(rep[0]);
+            for (int v = 0; v < w; v++) {
+                close(workers[v].to);
+                close(workers[v].from);
+            }
+            worker_loop(w, req[0], rep[1], nx, settings, setup, render);
+            _exit(0);
+        }
+        close(req[0]);
+        close(rep[1]);
+        workers[w].to = req[1];
+        workers[w].from = rep[0];
+        if (pid < 0) {
+            std::cerr << "strips: fork: " << strerror(errno) << std::endl;
+            shut_down(workers, true);
+            return false;
+        }
+        workers[w].pid = pid;
+    }
+    started();
+
+    stats.samples = 0;
+    stats.strips.assign(n, 0);
+    stats.busy_ms.assign(n, 0);
+
+    std::vector<char> finished(nstrips, 0);
+    int next = 0;          // next strip to hand out
+    int next_done = 0;     // first strip not yet passed to done
+    int pending = 0;       // strips handed out but not back yet
+
+    // the next strip for worker w, or exit once there are none left
+    auto hand_out = [&](int w) {
+        StripRequest req;
+        req.magic = STRIP_MAGIC;
+        req.y0 = next * rows;
+        req.rows = next < nstrips ? std::min(rows, ny - req.y0) : 0;
+        workers[w].strip = next < nstrips ? next++ : -1;
+        if (workers[w].strip >= 0) pending++;
+        return write_full(workers[w].to, &req, sizeof req);
+    };
+
+    bool ok = true;
+    for (int w = 0; w < n && ok; w++)
+        ok = hand_out(w);
+
+    std::vector<pollfd> fds;
+    std::vector<int> owner;
+    while (ok && pending > 0) {
+        fds.clear();
+        owner.clear();
+        for (int w = 0; w < n; w++) {
+            if (workers[w].strip < 0) continue;
+            pollfd p;
+            p.fd = workers[w].from;
+            p.events = POLLIN;
+            p.revents = 0;
+            fds.push_back(p);
+            owner.push_back(w);
+        }
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+
+        for (size_t k = 0; k < fds.size() && ok; k++) {
+            if (!fds[k].revents) continue;
+            int w = owner[k];
+            int s = workers[w].strip;
+            StripReply rep;
+            int y0 = s * rows, nrows = std::min(rows, ny - y0);
+            if (!read_full(workers[w].from, &rep, sizeof rep) || rep.magic != STRIP_MAGIC ||
+                rep.y0 != y0 || rep.rows != nrows || rep.nx != nx ||
+                !read_full(workers[w].from, rgb + (size_t) y0 * nx * 3, (size_t) nrows * nx * 3)) {
+                std::cerr << "strips: worker " << w << " failed on rows " << y0 << "-"
+                          << y0 + nrows - 1 << std::endl;
+                ok = false;
+                break;
+            }
+            pending--;
+            finished[s] = 1;
+            stats.samples += rep.samples;
+            stats.strips[w]++;
+            stats.busy_ms[w] += rep.ms;
+
+            for (; next_done < nstrips && finished[next_done]; next_done++)
+                done(next_done * rows, std::min(rows, ny - next_done * rows));
+            ok = hand_out(w);
+        }
+    }
+
+    shut_down(workers, !ok);
+    return ok;
+}
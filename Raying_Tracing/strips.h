@@ -0,0 +1,71 @@
+#ifndef STRIPS_H
+#define STRIPS_H
+
+#include <functional>
+#include <vector>
+
+// Renders one image with several worker processes.
+//
+// The coordinator forks the workers and talks to each over a pair of
+// pipes. It hands out horizontal strips of rows one at a time, to
+// whichever worker is idle. A worker renders the strip and sends back its
+// 8-bit RGB rows, and the coordinator copies them into the image. Every
+// message is a fixed-size header followed, in replies, by the pixels, so
+// the pipes could be swapped for sockets to workers on other hosts.
+//
+//   request   StripRequest              rows == 0 asks the worker to exit
+//   reply     StripReply, rows * nx * 3 bytes of pixels
+//
+// Messages are sent in host byte order; the magic value catches a peer
+// with the other one.
+
+struct StripRequest
+{
+    unsigned magic;
+    int y0, rows;
+};
+
+struct StripReply
+{
+    unsigned magic;
+    int y0, rows, nx;
+    long long samples;   // rays cast for the strip
+    double ms;           // time the worker spent rendering it
+};
+
+const unsigned STRIP_MAGIC = 0x52545331;   // "RTS1"
+
+struct StripSettings
+{
+    int processes = 2;
+    int rows = 0;        // rows per strip, 0: about 4 strips per worker
+    bool pin = false;    // pin worker w to NUMA node w % nodes
+};
+
+// called in a worker, once after it started (and was pinned)
+typedef std::function<void(int worker)> WorkerSetup;
+// renders rows [y0, y0 + rows) of the image into rgb, returns the rays cast
+typedef std::function<long long(int y0, int rows, unsigned char* rgb)> StripRenderer;
+// called in the coordinator once every worker has been forked; threads
+// may only be started from here on, as a forked child of a multithreaded
+// process may not start threads of its own
+typedef std::function<void()> WorkersStarted;
+// called in the coordinator with the first row not yet handed to it, each
+// time the completed rows at the top of the image grow
+typedef std::function<void(int y0, int rows)> RowsDone;
+
+struct StripStats
+{
+    long long samples = 0;
+    std::vector<int> strips;        // per worker
+    std::vector<double> busy_ms;    // per worker
+};
+
+// Renders the nx x ny image into rgb (nx * ny * 3 bytes) with
+// settings.processes forked workers. Returns false, with a message on
+// stderr, if a worker could not be started or died.
+bool render_strips(int nx, int ny, const StripSettings& settings, unsigned char* rgb,
+                   const WorkerSetup& setup, const StripRenderer& render, const WorkersStarted& started,
+                   const RowsDone& done, StripStats& stats);
+
+#endif
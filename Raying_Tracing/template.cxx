@@ -1,173 +1,843 @@
 #include <cmath>
-#include <limits>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
 #include <cfloat>
 #include <vector>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sys/resource.h>
 #include <glm/glm.hpp>
 
+#include "parallel.h"
+#include "scene.h"
+#include "bvh.h"
+#include "output.h"
+#include "sampling.h"
+#include "scene_file.h"
+#include "camera.h"
+#include "wavefront.h"
+#include "gbuffer.h"
+#include "tiles.h"
+#include "strips.h"
+#include "cost.h"
+#include "tracer.h"
+
 using namespace std;
 
-using vec3 = glm::dvec3;
+vector<Sphere> spheres = {
+    Sphere(200, vec3(  0, -300, -1200), vec3(), vec3(.8, .8, .8), DIFF),
+    Sphere(200, vec3(-80, -150, -1200), vec3(), vec3(.7, .7, .7), DIFF),
+    Sphere(200, vec3( 70, -100, -1200), vec3(), vec3(.9, .9, .9), DIFF)
+};
 
-struct Ray
-{
-    // origin and direction of this ray
-    vec3 o, d; 
+Mesh mesh;                // triangles traced along with the spheres
 
-    // arg d should always be normalized vector
-    Ray (vec3 o, vec3 d) : o(o), d(d) {} 
-};
+vec3 eye(0, 0, 200);      // camera position
+vec3 light(0, 0, 200);    // light source position
 
-// types of the surface
-// - DIFFuse, SPECular, REREective
-enum Refl_t { DIFF, SPEC, REFR };
+PixelOrder pixel_order = ORDER_TILES;
 
-// small constant
-const double eps = 1e-4;
+#ifdef TRACER_COST
+// cost of every pixel so far
+vector<PixelCost> cost_map;
+#endif
 
-struct Sphere
+// builds world<T>() from the scene above and reports its BVHs
+template <typename T>
+void setup_world()
 {
-    double r;      // radius
-    vec3 p;        // position (center)
-    vec3 e;        // emission
-    vec3 c;        // color
-    Refl_t refl;   // reflection type (DIFFuse, SPECular, REFRactive)
+    build_world<T>(spheres, mesh, eye, light);
+    if (!use_bvh) return;
 
-    Sphere(double r, vec3 p, vec3 e, vec3 c, Refl_t refl)
-        : r{r}, p{p}, e{e}, c{c}, refl{refl} {}
+    const World<T>& w = world<T>();
+    cerr << "bvh: " << w.spheres.size() << " spheres, " << w.bvh.nodes.size() << " nodes, depth "
+         << w.bvh.depth() << ", built in " << w.bvh_ms << " ms (" << Precision<T>::name() << ")" << endl;
 
-    double intersect(const Ray& ray) const
-    {
-	// intersects with t > eps, return t
-	// otherwise, return 0
-	    
-	vec3 op = ray.o - p;
-	double b = glm::dot(op, 2.0 * ray.d);
-        double a = glm::dot(ray.d, ray.d);
-        double c = glm::dot(op, op) - (r * r);
-        double t =  (-b + sqrt((b * b) - (4.0 * a * c))) / (2.0 * a);
-        double t2 = (-b - sqrt((b * b) - (4.0 * a * c))) / (2.0 * a);
-	if (t > eps && t2 > eps) {
-		return min(t, t2);
-	}
-	else if (t <= eps && t2 <= eps) return 0.0;
-	else if (t > eps) return t;
-	else return t2;
-    }
+    if (w.mesh.triangles() == 0) return;
+    double n = (double) w.mesh.triangles();
+    cerr << "bvh: " << w.mesh.triangles() << " triangles, " << w.mesh_bvh.nodes.size() << " nodes, depth "
+         << w.mesh_bvh.depth() << ", built in " << w.mesh_bvh_ms << " ms (" << Precision<T>::name() << "); "
+         << "bytes per triangle: mesh " << w.mesh.bytes() / n << ", bvh " << w.mesh_bvh.bytes() / n << endl;
+}
 
+// 8-bit RGB image the tracer renders into before it is written out
+struct Framebuffer
+{
+    int nx, ny;
+    vector<unsigned char> rgb;   // nx * ny * 3, rows in tracing order
 
-    vec3 normal(vec3& v)
-    {
-	return glm::normalize(v - p);
-    }
+    Framebuffer(int nx, int ny) : nx(nx), ny(ny), rgb((size_t) nx * ny * 3) {}
+
+    unsigned char* pixel(int i, int j) { return &rgb[((size_t) j * nx + i) * 3]; }
 };
 
-vector<Sphere> spheres = {
-    Sphere(200, vec3(  0, -300, -1200), vec3(), vec3(.8, .8, .8), DIFF),
-    Sphere(200, vec3(-80, -150, -1200), vec3(), vec3(.7, .7, .7), DIFF),
-    Sphere(200, vec3( 70, -100, -1200), vec3(), vec3(.9, .9, .9), DIFF)
+// adaptive anti-aliasing
+//   every pixel starts with grid x grid jittered samples, one per stratum,
+//   then gets further rounds of grid x grid samples while the standard
+//   error of its mean luminance is above threshold, up to max_spp samples
+struct AASettings
+{
+    int grid = 1;             // 1: one ray through the pixel center, no AA
+    int max_spp = 64;
+    double threshold = 0.5 / 255;
 };
 
-vec3 eye(0, 0, 200);      // camera position
-vec3 light(0, 0, 200);    // light source position
+AASettings aa;
 
-bool hit(const Ray& ray, double& t, int& surface_idx)
+// render options (see main() for the command line)
+struct Options
 {
-    double valt = INT_MAX;
-    bool hit = false;
-    for (int i = 0; i < 3; i++) {
-    	double tmp = spheres[i].intersect(ray);
-	if (tmp > eps && tmp < valt) {
-   	    hit = true;
-	    valt = tmp;
-	    t = valt;
-	    surface_idx = i;
-	}
-    }
+    int threads = 1;     // worker threads, 0 = one per hardware thread
+    int tile = 16;       // tile size in pixels
+    bool baseline = false;  // also render single-threaded and report speedup
+    int nspheres = 0;    // > 0: replace the scene with that many random spheres
+    string scene;        // binary scene file to render instead
+    string mesh;         // OBJ file of triangles to add
+    bool fit = false;    // move and scale the mesh to fit_center, fit_size
+    vec3 fit_center;
+    double fit_size = 0;
+    int tessellate = 0;  // > 0: replace the spheres by meshes of that many segments
+    bool move_light = false;
+    vec3 light;          // light position, if move_light
+    bool bvh = true;     // use the BVH in hit()
+    string kernel = "auto";  // sphere intersection kernel
+    PPMFormat format = PPM_P6;
+    bool path_trace = false;
+    PathTraceSettings pt;
+#ifdef TRACER_FLOAT
+    bool use_float = true;   // trace in float instead of double
+#else
+    bool use_float = false;
+#endif
+    double check_tolerance = -1;  // >= 0: render in both precisions and compare
+    string relight;      // file of "X,Y,Z outfile" lines to re-light, - for stdin
+    StripSettings strips;
+    bool use_strips = false;  // render with forked worker processes
+    int band = 0;        // > 0: render and write that many rows at a time
+    string cost_file;    // per-pixel cost heatmap (TRACER_COST builds)
+    string compare_file;      // reference image to compare the render with
+    double compare_tolerance = 0;
+    CostMetric cost_metric = COST_TESTS;
+};
+
+// parses "x,y,z"
+bool parse_vec3(const string& s, vec3& v)
+{
+    return sscanf(s.c_str(), "%lf,%lf,%lf", &v[0], &v[1], &v[2]) == 3;
+}
+
+// color of pixel (i, j) with adaptive anti-aliasing, adds the number of
+// rays cast to samples
+template <typename T>
+vec3 pixel_color_aa(const Camera& cam, int i, int j, long long& samples)
+{
+    Rng rng(i, j);
+    int g = aa.grid;
+    vec3 sum;
+    // running mean and sum of squared deviations of the luminance (Welford)
+    double mean = 0, m2 = 0;
+    int n = 0;
+
+    do {
+        for (int sy = 0; sy < g; sy++) {
+            for (int sx = 0; sx < g; sx++) {
+                double x = i - 0.5 + (sx + rng.uniform()) / g;
+                double y = j - 0.5 + (sy + rng.uniform()) / g;
+                RayT<T> r(cam.primary(x, y));
+                vec3 c(ray_color(r));
+                sum += c;
+
+                double lum = 0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2];
+                n++;
+                double delta = lum - mean;
+                mean += delta / n;
+                m2 += delta * (lum - mean);
+            }
+        }
+        // variance of the mean is (m2 / (n - 1)) / n
+    } while (n + g * g <= aa.max_spp &&
+             (aa.threshold <= 0 || m2 / (n - 1.0) / n > aa.threshold * aa.threshold));
 
-    return hit;
+    samples += n;
+    return sum / (double) n;
 }
 
-// Calculating the intensity using Lambert's law
-double lambert(int surface_idx, Ray& ray, double t)
+// render the pixels of job k, returns the number of rays cast; fb holds
+// image rows y0 and below
+template <typename T>
+long long render_tile(const Camera& cam, Framebuffer& fb, int y0, const TileOrder& tiles, int k)
 {
-    vec3 Pn = eye + (t * ray.d);
-    vec3 n_hat = spheres[surface_idx].normal(Pn);
-    vec3 l_hat = glm::normalize(light - Pn);
-    double lambC = glm::dot(n_hat, l_hat);
-    if (lambC > 0) return lambC;
-    else return 0;
+    long long samples = 0;
+    tiles.for_each_pixel(k, [&](int i, int j) {
+#ifdef TRACER_COST
+        pixel_cost = PixelCost();
+#endif
+        vec3 color;
+        if (aa.grid > 1) {
+            color = pixel_color_aa<T>(cam, i, y0 + j, samples);
+        }
+        else {
+            RayT<T> r(cam.primary(i, y0 + j));
+            color = vec3(ray_color(r));
+            samples++;
+        }
+
+        unsigned char* px = fb.pixel(i, j);
+        px[0] = to_byte(color[0]);
+        px[1] = to_byte(color[1]);
+        px[2] = to_byte(color[2]);
+#ifdef TRACER_COST
+        if (!cost_map.empty()) cost_map[(size_t) (y0 + j) * cam.nx + i] = pixel_cost;
+#endif
+    });
+    return samples;
+}
+
+// Simple ray tracer
+// splits the image into tile x tile blocks (or rows, see pixel_order) and
+// renders them on nthreads workers; every pixel is computed the same way
+// no matter which thread renders it or in which order, so the image does
+// not depend on the thread count or the pixel order
+//
+// with a writer, every band of tile rows is handed to it, in order, as
+// soon as all of its tiles are done
+//
+// fb may hold only a strip of the image, rows y0 to y0 + fb.ny - 1
+//
+// returns the number of primary rays cast
+template <typename T>
+long long tracer(const Camera& cam, Framebuffer& fb, int tile, int nthreads, RowWriter* writer = nullptr,
+                 int y0 = 0)
+{
+    TileOrder tiles(cam.nx, fb.ny, tile, pixel_order);
+
+    mutex band_lock;
+    vector<int> tiles_done(tiles.ty, 0);
+    int next_band = 0;
+    atomic<long long> samples(0);
+
+    parallel_for(tiles.count(), nthreads, [&](int k, int) {
+        samples += render_tile<T>(cam, fb, y0, tiles, k);
+
+        if (!writer) return;
+        lock_guard<mutex> g(band_lock);
+        tiles_done[tiles.jobs[k] / tiles.tx]++;
+        for (; next_band < tiles.ty && tiles_done[next_band] == tiles.tx; next_band++) {
+            int y = next_band * tiles.th;
+            writer->push(fb.pixel(0, y), min(tiles.th, fb.ny - y));
+        }
+    });
+    return samples;
 }
 
+// time a render (and the output, when streamed) in milliseconds
+template <typename T>
+double timed_tracer(const Camera& cam, Framebuffer& fb, int tile, int nthreads,
+                    RowWriter* writer = nullptr, long long* samples = nullptr)
+{
+    auto start = chrono::steady_clock::now();
+    long long n = tracer<T>(cam, fb, tile, nthreads, writer);
+    if (samples) *samples = n;
+    if (writer) writer->finish();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// primary hits of every pixel, for re-lighting
+template <typename T>
+void fill_gbuffer(const Camera& cam, GBufferT<T>& g, int nthreads)
+{
+    g.resize(cam.nx, cam.ny);
+    TileOrder rows(cam.nx, cam.ny, 1, ORDER_SCANLINE);
+    parallel_for(rows.count(), nthreads, [&](int k, int) { trace_primary(cam, rows, k, g); });
+}
 
-// Calculating the color of the ray
-vec3 ray_color(Ray& ray)
+// --relight: traces the primary rays once into a G-buffer and writes
+// outfile from it, then one image per "X,Y,Z outfile" line of the
+// relight file, shaded from the G-buffer alone
+template <typename T>
+void relight_session(const Camera& cam, const string& lights, Framebuffer& fb,
+                     RowWriter& writer, int nthreads)
 {
-    double t;
-    int surface_idx;
+    GBufferT<T> g;
+    auto start = chrono::steady_clock::now();
+    fill_gbuffer(cam, g, nthreads);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "gbuffer: " << cam.nx << "x" << cam.ny << " primary hits in " << ms << " ms, "
+         << g.size() * (10 * sizeof(T) + sizeof(int)) / 1e6 << " MB" << endl;
+
+    shade_gbuffer(g, &fb.rgb[0], nthreads);
+    writer.push(fb.pixel(0, 0), cam.ny);
+    writer.finish();
 
-    bool is_hit = hit(ray, t, surface_idx);
-    if (is_hit) {
-        return spheres[surface_idx].c * lambert(surface_idx, ray, t);
+    ifstream file;
+    if (lights != "-") {
+        file.open(lights);
+        if (!file) {
+            cerr << "relight: cannot open " << lights << endl;
+            exit(1);
+        }
     }
-    else {
-        return vec3{0.0, 0.0, 0.0};
+    istream& in = lights == "-" ? cin : file;
+
+    string line;
+    for (int n = 1; getline(in, line); n++) {
+        char xyz[256], out[4096];
+        vec3 l;
+        if (line.empty() || line[0] == '#') continue;
+        if (sscanf(line.c_str(), "%255s %4095s", xyz, out) != 2 || !parse_vec3(xyz, l)) {
+            cerr << "relight: " << lights << ":" << n << ": expected X,Y,Z outfile.ppm" << endl;
+            exit(1);
+        }
+
+        start = chrono::steady_clock::now();
+        world<T>().light = glm::tvec3<T>(l);
+        shade_gbuffer(g, &fb.rgb[0], nthreads);
+        ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        ofstream fout(out, ios::binary);
+        write_ppm_header(fout, PPM_P6, cam.nx, cam.ny);
+        write_ppm_rows(fout, PPM_P6, &fb.rgb[0], cam.nx, cam.ny);
+        if (!fout) {
+            cerr << "relight: cannot write " << out << endl;
+            exit(1);
+        }
+        cerr << "relight: light " << l[0] << "," << l[1] << "," << l[2] << " -> " << out
+             << ", shaded in " << ms << " ms" << endl;
     }
 }
 
-// Simple ray tracer
-void tracer(int nx, int ny, int d, double theta, ofstream& fout)
+// --processes: the image rendered in strips by forked workers, each of
+// which builds its own BVH (on its own NUMA node with --pin) and traces
+// with nthreads threads; rows go to the writer as soon as the strips at
+// the top of the image are in
+template <typename T>
+void strip_session(const Camera& cam, const StripSettings& settings, Framebuffer& fb, ostream& fout,
+                   PPMFormat format, int tile, int nthreads)
+{
+    // the writer thread is started once the workers are forked, which
+    // leave with _exit() without flushing fout; no row comes back before
+    unique_ptr<RowWriter> writer;
+    StripStats stats;
+    auto start = chrono::steady_clock::now();
+
+    bool ok = render_strips(cam.nx, cam.ny, settings, &fb.rgb[0],
+        [&](int) { setup_world<T>(); },
+        [&](int y0, int rows, unsigned char* rgb) {
+            Framebuffer strip(cam.nx, rows);
+            long long n = tracer<T>(cam, strip, tile, nthreads, nullptr, y0);
+            memcpy(rgb, &strip.rgb[0], strip.rgb.size());
+            return n;
+        },
+        [&]() { writer.reset(new RowWriter(fout, format, cam.nx, cam.ny)); },
+        [&](int y0, int rows) { writer->push(fb.pixel(0, y0), rows); },
+        stats);
+    if (!ok) exit(1);
+    writer->finish();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "strips: " << cam.nx << "x" << cam.ny << " on " << settings.processes << " process(es) x "
+         << nthreads << " thread(s): " << ms << " ms, " << stats.samples / (ms * 1e3) << " Mrays/s" << endl;
+    for (size_t w = 0; w < stats.strips.size(); w++)
+        cerr << "strips: worker " << w << ": " << stats.strips[w] << " strips, "
+             << stats.busy_ms[w] << " ms tracing" << endl;
+}
+
+// --band: renders the image band by band with render(y0, band), into two
+// buffers of rows rows each. A buffer is reused only once the writer has
+// written what it held, so the writer can write one band while the next
+// is rendered, and memory does not grow with the image height. render
+// pushes the band's rows to the writer; returns the sum of what render
+// returned
+long long render_bands(int nx, int ny, int rows, RowWriter& writer,
+                       const function<long long(int y0, Framebuffer& band)>& render)
+{
+    Framebuffer bands[2] = {Framebuffer(nx, rows), Framebuffer(nx, rows)};
+    long long samples = 0;
+    for (int b = 0, y0 = 0; y0 < ny; b++, y0 += rows) {
+        Framebuffer& fb = bands[b % 2];
+        // this buffer last held the band before the previous one
+        writer.wait_written(y0 - rows);
+        fb.ny = min(rows, ny - y0);
+        samples += render(y0, fb);
+    }
+    return samples;
+}
+
+// peak resident set size of the process so far, in MB
+double peak_rss_mb()
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+    return ru.ru_maxrss / 1024.0;   // kB on Linux
+}
+
+void report_memory(int nx, int band)
 {
-    double h = (2.0 * d * (tan(theta / 2.0)));
-    double w =  (nx / (double) ny) * h;
-    double scalef = w / (double) nx;
+    cerr << "memory: peak RSS " << peak_rss_mb() << " MB";
+    if (band > 0)
+        cerr << ", with two bands of " << band << " rows (" << 2.0 * nx * band * 3 / 1e6 << " MB)";
+    cerr << endl;
+}
 
-    fout << "P3\n" << nx << " " << ny << "\n" << "255\n";
+// how far apart two images of the same size are, in 8-bit levels
+struct ImageDiff
+{
+    double rmse = 0;
+    int worst = 0;
+    double off = 0;      // fraction of channels off by more than 1
+};
 
-    for (int j = 0; j < ny; j++) {
-        for (int i = 0; i < nx; i++) {
-            vec3 point;
-		
-	    // transform: translate, scale
-            point[0] = ((double) i + (-nx / 2.0)) * scalef;
-            point[1] = ((double) j + (-ny / 2.0)) * scalef;
-            point[2] = d - d;
-		
-            vec3 worldn = glm::normalize(point - eye);
-            Ray r = Ray(eye, worldn);
-            vec3 color = ray_color(r);
-		
-            fout << (int) (color[0] * 255) << " " << (int) (color[1] * 255) << " " << (int) (color[2] * 255) << " ";
+ImageDiff diff_images(const vector<unsigned char>& a, const vector<unsigned char>& b)
+{
+    ImageDiff d;
+    double sum2 = 0;
+    size_t off = 0;
+    for (size_t k = 0; k < a.size(); k++) {
+        int e = abs((int) a[k] - (int) b[k]);
+        sum2 += (double) e * e;
+        d.worst = max(d.worst, e);
+        if (e > 1) off++;
+    }
+    d.rmse = sqrt(sum2 / a.size());
+    d.off = (double) off / a.size();
+    return d;
+}
 
-      }
-      fout<<"\n";
+// --compare: exits 1 if fb is further than tolerance (RMS, in 8-bit
+// levels) from the P6 image in file
+void compare_reference(const Framebuffer& fb, const string& file, double tolerance)
+{
+    ifstream in(file, ios::binary);
+    int nx, ny;
+    vector<unsigned char> ref;
+    if (!in || !read_ppm(in, nx, ny, ref)) {
+        cerr << "compare: cannot read " << file << " as a P6 image" << endl;
+        exit(1);
+    }
+    if (nx != fb.nx || ny != fb.ny) {
+        cerr << "compare: " << file << " is " << nx << "x" << ny << ", the render " << fb.nx << "x" << fb.ny << endl;
+        exit(1);
+    }
+    ImageDiff d = diff_images(fb.rgb, ref);
+    cerr << "compare: " << file << ": RMS difference " << d.rmse << ", max " << d.worst << ", "
+         << 100 * d.off << "% of channels off by more than 1" << endl;
+    if (d.rmse > tolerance) {
+        cerr << "compare: RMS difference above tolerance " << tolerance << endl;
+        exit(1);
     }
 }
 
+#ifdef TRACER_FLOAT
+#define PRECISION_DEFAULT "float"
+#else
+#define PRECISION_DEFAULT "double"
+#endif
+
+void usage()
+{
+    cerr << "Usage:  template [options] nx ny outfile.ppm\n"
+         << "  --threads N   render on N threads (0 = all hardware threads, default 1)\n"
+         << "  --tile N      tile size in pixels (default 16)\n"
+         << "  --order O     pixel order: tiles (default), morton or scanline\n"
+         << "  --baseline    also render on one thread, report speedup and compare\n"
+         << "  --spheres N   render N random spheres instead of the default scene\n"
+         << "  --scene F     render the binary scene file F (see scene_convert)\n"
+         << "  --mesh F      add the triangles of the OBJ file F\n"
+         << "  --mesh-fit X,Y,Z,S\n"
+         << "                center the mesh on X,Y,Z and scale its longest side to S\n"
+         << "  --tessellate N\n"
+         << "                replace every sphere by a mesh of N segments around\n"
+         << "  --no-bvh      test every sphere and triangle for every ray\n"
+         << "  --shadows     cast shadow rays\n"
+         << "  --light X,Y,Z move the light\n"
+         << "  --kernel K    intersection kernels: auto, avx2, sse2 or scalar (default auto)\n"
+         << "  --format F    p6 (binary, default) or p3 (ASCII)\n"
+         << "  --aa G        adaptive anti-aliasing, rounds of G x G stratified samples\n"
+         << "  --aa-max N    at most N samples per pixel (default 64)\n"
+         << "  --aa-threshold T\n"
+         << "                sample until the standard error of the pixel luminance\n"
+         << "                is below T (default 0.5/255, 0 = always take --aa-max)\n"
+         << "  --pt SPP      path trace with SPP paths per pixel instead of Lambert shading\n"
+         << "  --pt-depth N  at most N bounces per path (default 32)\n"
+         << "  --wavefront N paths in flight per wavefront chunk (default 262144)\n"
+         << "  --precision P trace in float or double (default " << PRECISION_DEFAULT << ")\n"
+         << "  --check-precision TOL\n"
+         << "                render in float and in double and fail if the RMS\n"
+         << "                difference is above TOL (in 8-bit levels)\n"
+         << "  --compare F TOL\n"
+         << "                fail if the RMS difference to the P6 image F is above TOL\n"
+         << "  --relight F   keep the primary hits and re-shade them for every\n"
+         << "                \"X,Y,Z outfile\" line of F (- for stdin)\n"
+         << "  --band N      render and write N rows at a time, so memory does not\n"
+         << "                grow with the image height\n"
+         << "  --processes N render in strips on N forked worker processes\n"
+         << "  --strip N     rows per strip (default: about 4 strips per process)\n"
+         << "  --pin         pin worker process w to NUMA node w % nodes\n"
+         << "  --cost-map F  write a heatmap of the per-pixel cost to F and a histogram\n"
+         << "                to stderr (needs a -DTRACER_COST build, make template_cost)\n"
+         << "  --cost-metric M\n"
+         << "                heatmap of tests (sphere and triangle tests, default),\n"
+         << "                steps (BVH nodes) or shade (shading time)\n";
+    exit(1);
+}
 
 int main(int argc, char* argv[])
 {
-    if (argc != 4) {
-	cerr << "Usage:  template nx ny outfile.ppm";
-	exit(1);
+    Options opt;
+    vector<char*> args;
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--threads" && a + 1 < argc)
+            opt.threads = std::stoi(argv[++a], nullptr);
+        else if (arg == "--tile" && a + 1 < argc)
+            opt.tile = std::stoi(argv[++a], nullptr);
+        else if (arg == "--order" && a + 1 < argc) {
+            if (!parse_order(argv[++a], pixel_order)) usage();
+        }
+        else if (arg == "--baseline")
+            opt.baseline = true;
+        else if (arg == "--spheres" && a + 1 < argc)
+            opt.nspheres = std::stoi(argv[++a], nullptr);
+        else if (arg == "--scene" && a + 1 < argc)
+            opt.scene = argv[++a];
+        else if (arg == "--mesh" && a + 1 < argc)
+            opt.mesh = argv[++a];
+        else if (arg == "--mesh-fit" && a + 1 < argc) {
+            if (sscanf(argv[++a], "%lf,%lf,%lf,%lf", &opt.fit_center[0], &opt.fit_center[1],
+                       &opt.fit_center[2], &opt.fit_size) != 4 || opt.fit_size <= 0)
+                usage();
+            opt.fit = true;
+        }
+        else if (arg == "--tessellate" && a + 1 < argc)
+            opt.tessellate = std::stoi(argv[++a], nullptr);
+        else if (arg == "--no-bvh")
+            opt.bvh = false;
+        else if (arg == "--shadows")
+            shadows = true;
+        else if (arg == "--light" && a + 1 < argc) {
+            if (!parse_vec3(argv[++a], opt.light)) usage();
+            opt.move_light = true;
+        }
+        else if (arg == "--kernel" && a + 1 < argc)
+            opt.kernel = argv[++a];
+        else if (arg == "--format" && a + 1 < argc) {
+            string f = argv[++a];
+            if (f == "p3") opt.format = PPM_P3;
+            else if (f == "p6") opt.format = PPM_P6;
+            else usage();
+        }
+        else if (arg == "--aa" && a + 1 < argc)
+            aa.grid = std::stoi(argv[++a], nullptr);
+        else if (arg == "--aa-max" && a + 1 < argc)
+            aa.max_spp = std::stoi(argv[++a], nullptr);
+        else if (arg == "--aa-threshold" && a + 1 < argc)
+            aa.threshold = std::stod(argv[++a], nullptr);
+        else if (arg == "--pt" && a + 1 < argc) {
+            opt.path_trace = true;
+            opt.pt.spp = std::stoi(argv[++a], nullptr);
+        }
+        else if (arg == "--pt-depth" && a + 1 < argc)
+            opt.pt.max_depth = std::stoi(argv[++a], nullptr);
+        else if (arg == "--wavefront" && a + 1 < argc)
+            opt.pt.wavefront = std::stoi(argv[++a], nullptr);
+        else if (arg == "--precision" && a + 1 < argc) {
+            string p = argv[++a];
+            if (p == "float") opt.use_float = true;
+            else if (p == "double") opt.use_float = false;
+            else usage();
+        }
+        else if (arg == "--check-precision" && a + 1 < argc)
+            opt.check_tolerance = std::stod(argv[++a], nullptr);
+        else if (arg == "--compare" && a + 2 < argc) {
+            opt.compare_file = argv[++a];
+            opt.compare_tolerance = std::stod(argv[++a], nullptr);
+        }
+        else if (arg == "--relight" && a + 1 < argc)
+            opt.relight = argv[++a];
+        else if (arg == "--band" && a + 1 < argc)
+            opt.band = std::stoi(argv[++a], nullptr);
+        else if (arg == "--processes" && a + 1 < argc) {
+            opt.strips.processes = std::stoi(argv[++a], nullptr);
+            opt.use_strips = true;
+        }
+        else if (arg == "--strip" && a + 1 < argc)
+            opt.strips.rows = std::stoi(argv[++a], nullptr);
+        else if (arg == "--pin")
+            opt.strips.pin = true;
+        else if (arg == "--cost-map" && a + 1 < argc)
+            opt.cost_file = argv[++a];
+        else if (arg == "--cost-metric" && a + 1 < argc) {
+            if (!parse_cost_metric(argv[++a], opt.cost_metric)) usage();
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+            usage();
+        else
+            args.push_back(argv[a]);
     }
+    if (args.size() != 3 || opt.tile < 1 || aa.grid < 1 || opt.pt.spp < 1 || opt.pt.max_depth < 0 ||
+        opt.strips.processes < 1 || opt.band < 0)
+        usage();
+#ifndef TRACER_COST
+    if (!opt.cost_file.empty()) {
+        cerr << "tracer: --cost-map needs a build with -DTRACER_COST (make template_cost)" << endl;
+        exit(1);
+    }
+#endif
+    if (!opt.cost_file.empty() && (opt.use_strips || opt.path_trace || !opt.relight.empty())) {
+        cerr << "tracer: --cost-map cannot be combined with --processes, --pt or --relight" << endl;
+        exit(1);
+    }
+    if (opt.path_trace && (!opt.mesh.empty() || opt.tessellate > 0)) {
+        cerr << "tracer: the path tracer only traces spheres, not --mesh or --tessellate" << endl;
+        exit(1);
+    }
+    if (opt.band > 0 && (opt.use_strips || !opt.relight.empty() || opt.baseline || opt.check_tolerance >= 0 ||
+                         !opt.cost_file.empty() || !opt.compare_file.empty())) {
+        cerr << "tracer: --band cannot be combined with --processes, --relight, --baseline, "
+             << "--check-precision, --cost-map or --compare, which keep the whole image" << endl;
+        exit(1);
+    }
+    if (opt.use_strips && (opt.path_trace || !opt.relight.empty() || opt.baseline || opt.check_tolerance >= 0 ||
+                           !opt.compare_file.empty())) {
+        cerr << "tracer: --processes cannot be combined with --pt, --relight, --baseline, --check-precision "
+             << "or --compare" << endl;
+        exit(1);
+    }
+    if (!opt.compare_file.empty() && !opt.relight.empty()) {
+        cerr << "tracer: --compare cannot be combined with --relight" << endl;
+        exit(1);
+    }
+    aa.max_spp = max(aa.max_spp, aa.grid * aa.grid);
 
-    int nx = std::stoi(argv[1], nullptr);
-    int ny = std::stoi(argv[2], nullptr);
-    char *fname = argv[3];
+    int nx = std::stoi(args[0], nullptr);
+    int ny = std::stoi(args[1], nullptr);
+    if (nx < 1 || ny < 1) usage();
+    char *fname = args[2];
+    int nthreads = opt.threads > 0 ? opt.threads : hardware_threads();
 
-    ofstream fout(fname);
+    ofstream fout(fname, ios::binary);
     if (!fout) {
         cerr << "tracer: cannot open input file " << fname << endl;
         exit(1);
     }
 
+    if (opt.nspheres > 0)
+        spheres = random_spheres(opt.nspheres);
+
+    if (!opt.scene.empty()) {
+        auto start = chrono::steady_clock::now();
+        SceneFile sf;
+        string err;
+        if (!sf.open(opt.scene, err)) {
+            cerr << "tracer: " << err << endl;
+            exit(1);
+        }
+        sf.spheres(spheres);
+        eye = vec3(sf.header().eye[0], sf.header().eye[1], sf.header().eye[2]);
+        light = vec3(sf.header().light[0], sf.header().light[1], sf.header().light[2]);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cerr << "scene: " << spheres.size() << " spheres from " << opt.scene
+             << ", loaded in " << ms << " ms" << endl;
+    }
+
+    if (opt.tessellate > 0) {
+        tessellate(spheres, opt.tessellate, mesh);
+        cerr << "mesh: " << spheres.size() << " spheres tessellated into " << mesh.triangles()
+             << " triangles" << endl;
+        spheres.clear();
+    }
+
+    if (!opt.mesh.empty()) {
+        auto start = chrono::steady_clock::now();
+        ifstream in(opt.mesh);
+        Mesh m;
+        string err;
+        if (!in || !read_mesh_obj(in, m, err)) {
+            cerr << "tracer: " << opt.mesh << ": " << (in ? err : "cannot open") << endl;
+            exit(1);
+        }
+        if (opt.fit) fit_mesh(m, opt.fit_center, opt.fit_size);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cerr << "mesh: " << m.triangles() << " triangles, " << m.vertices.size() << " vertices from "
+             << opt.mesh << ", loaded in " << ms << " ms" << endl;
+
+        // appended to the tessellated spheres, if any
+        uint32_t base = (uint32_t) mesh.vertices.size();
+        mesh.vertices.insert(mesh.vertices.end(), m.vertices.begin(), m.vertices.end());
+        mesh.colors.insert(mesh.colors.end(), m.colors.begin(), m.colors.end());
+        for (uint32_t v : m.indices)
+            mesh.indices.push_back(base + v);
+    }
+
+    if (opt.move_light)
+        light = opt.light;
+
+    string kernel = select_kernel(opt.kernel);
+    if (kernel.empty()) {
+        cerr << "tracer: kernel " << opt.kernel << " is not available on this CPU" << endl;
+        exit(1);
+    }
+    cerr << "kernel: " << kernel << endl;
+
     // trace the ray to generate nx x ny image using
     //   the virtual film placed at the distance of 200 in z-axis (negative z direction) from the eye
     //   vfov of 120
-    tracer(nx, ny, 200, 120, fout);
+    Camera cam(nx, ny, 200, 120, eye);
+    // with --band there is no frame buffer, only band buffers
+    Framebuffer fb(nx, opt.band > 0 ? 0 : ny);
+
+    use_bvh = opt.bvh;
+    if (opt.use_strips) {
+        // the workers build what they trace, so nothing is built here
+        if (opt.use_float)
+            strip_session<float>(cam, opt.strips, fb, fout, opt.format, opt.tile, nthreads);
+        else
+            strip_session<double>(cam, opt.strips, fb, fout, opt.format, opt.tile, nthreads);
+        fout.close();
+        return 0;
+    }
+
+    // the path tracer always walks the BVH, and always in double:
+    // its scenes rely on huge spheres for walls
+    use_bvh = opt.bvh || opt.path_trace;
+    if (opt.path_trace) opt.use_float = false;
+    bool check = opt.check_tolerance >= 0 && !opt.path_trace;
+    if (!opt.use_float || check)
+        setup_world<double>();
+    if (opt.use_float || check)
+        setup_world<float>();
+
+    RowWriter writer(fout, opt.format, nx, ny);
+
+    if (opt.path_trace) {
+        auto start = chrono::steady_clock::now();
+        vector<vec3> radiance;
+        PathTraceStats st;
+        auto render = [&](int y0, Framebuffer& band) {
+            PathTraceStats s = path_trace(cam, world_double.spheres, world_double.bvh, opt.pt, nthreads,
+                                          radiance, y0, band.ny);
+            st.paths += s.paths;
+            st.segments += s.segments;
+
+            // gamma 2.2
+            for (size_t k = 0; k < radiance.size(); k++) {
+                for (int c = 0; c < 3; c++) {
+                    double v = min(max(radiance[k][c], 0.0), 1.0);
+                    band.rgb[k * 3 + c] = to_byte(pow(v, 1 / 2.2) + 0.5 / 255);
+                }
+            }
+            writer.push(band.pixel(0, 0), band.ny);
+            return s.paths;
+        };
+        if (opt.band > 0) render_bands(nx, ny, opt.band, writer, render);
+        else render(0, fb);
+        writer.finish();
+        double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cerr << "pt: " << nx << "x" << ny << " at " << opt.pt.spp << " spp on " << nthreads
+             << " thread(s): " << s * 1e3 << " ms, " << st.paths / s / 1e6 << " Msamples/s, "
+             << st.segments / s / 1e6 << " Mrays/s, " << (double) st.segments / st.paths
+             << " rays per sample" << endl;
+        report_memory(nx, opt.band);
+        if (!opt.compare_file.empty())
+            compare_reference(fb, opt.compare_file, opt.compare_tolerance);
+        fout.close();
+        return 0;
+    }
+
+    if (!opt.relight.empty()) {
+        // one sample per pixel, from the camera's primary rays
+        if (aa.grid > 1) {
+            cerr << "tracer: --relight does not support --aa" << endl;
+            exit(1);
+        }
+        if (opt.use_float)
+            relight_session<float>(cam, opt.relight, fb, writer, nthreads);
+        else
+            relight_session<double>(cam, opt.relight, fb, writer, nthreads);
+        fout.close();
+        return 0;
+    }
+
+#ifdef TRACER_COST
+    if (!opt.cost_file.empty())
+        cost_map.assign((size_t) nx * ny, PixelCost());
+#endif
+
+    long long samples;
+    double ms;
+    if (opt.band > 0) {
+        auto start = chrono::steady_clock::now();
+        samples = render_bands(nx, ny, opt.band, writer, [&](int y0, Framebuffer& band) {
+            return opt.use_float ? tracer<float>(cam, band, opt.tile, nthreads, &writer, y0)
+                                 : tracer<double>(cam, band, opt.tile, nthreads, &writer, y0);
+        });
+        writer.finish();
+        ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    else {
+        ms = opt.use_float ? timed_tracer<float>(cam, fb, opt.tile, nthreads, &writer, &samples)
+                           : timed_tracer<double>(cam, fb, opt.tile, nthreads, &writer, &samples);
+    }
+    double rays = (double) samples;
+    cerr << "tracer: " << nx << "x" << ny << " on " << nthreads << " thread(s), "
+         << (opt.use_float ? "float" : "double") << ", "
+         << (opt.format == PPM_P6 ? "P6" : "P3") << " output: "
+         << ms << " ms, " << rays / (ms * 1e3) << " Mrays/s" << endl;
+    if (aa.grid > 1)
+        cerr << "aa: " << rays / ((double) nx * ny) << " samples per pixel on average" << endl;
+    report_memory(nx, opt.band);
+
+#ifdef TRACER_COST
+    if (!opt.cost_file.empty()) {
+        ofstream cout_map(opt.cost_file, ios::binary);
+        write_cost_map(cout_map, cost_map, nx, ny, opt.cost_metric);
+        if (!cout_map) {
+            cerr << "tracer: cannot write " << opt.cost_file << endl;
+            exit(1);
+        }
+        cerr << "cost: " << cost_metric_name(opt.cost_metric) << " heatmap written to " << opt.cost_file << endl;
+        print_cost_summary(cerr, cost_map);
+        // the --baseline and --check-precision renders below would overwrite it
+        cost_map.clear();
+    }
+#endif
+
+    if (!opt.compare_file.empty())
+        compare_reference(fb, opt.compare_file, opt.compare_tolerance);
+
+    if (opt.baseline) {
+        Framebuffer ref(nx, ny);
+        double ms1 = opt.use_float ? timed_tracer<float>(cam, ref, opt.tile, 1)
+                                   : timed_tracer<double>(cam, ref, opt.tile, 1);
+        cerr << "tracer: 1 thread: " << ms1 << " ms, speedup " << ms1 / ms << "x, "
+             << (ref.rgb == fb.rgb ? "images identical" : "IMAGES DIFFER") << endl;
+        if (ref.rgb != fb.rgb) exit(1);
+    }
+
+    if (check) {
+        // the other precision, compared with the image just written
+        Framebuffer other(nx, ny);
+        double ms2 = opt.use_float ? timed_tracer<double>(cam, other, opt.tile, nthreads)
+                                   : timed_tracer<float>(cam, other, opt.tile, nthreads);
+        ImageDiff d = diff_images(fb.rgb, other.rgb);
+        double ms_float = opt.use_float ? ms : ms2, ms_double = opt.use_float ? ms2 : ms;
+        cerr << "precision: float " << ms_float << " ms, double " << ms_double << " ms; "
+             << "RMS difference " << d.rmse << ", max " << d.worst << ", "
+             << 100 * d.off << "% of channels off by more than 1" << endl;
+        if (d.rmse > opt.check_tolerance) {
+            cerr << "precision: RMS difference above tolerance " << opt.check_tolerance << endl;
+            exit(1);
+        }
+    }
+
     fout.close();
 
     return 0;
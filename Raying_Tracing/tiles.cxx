@@ -0,0 +1,68 @@
+#include "tiles.h"
+
+#include <algorithm>
+
+namespace {
+
+// 0, 1, ..., w * h - 1 as row * w + column, sorted by Z-order
+std::vector<int> morton_cells(int w, int h)
+{
+    std::vector<int> cells(w * h);
+    for (int k = 0; k < w * h; k++)
+        cells[k] = k;
+    std::sort(cells.begin(), cells.end(), [w](int a, int b) {
+        return morton2(a % w, a / w) < morton2(b % w, b / w);
+    });
+    return cells;
+}
+
+std::vector<int> row_cells(int w, int h)
+{
+    std::vector<int> cells(w * h);
+    for (int k = 0; k < w * h; k++)
+        cells[k] = k;
+    return cells;
+}
+
+}
+
+bool parse_order(const std::string& s, PixelOrder& order)
+{
+    if (s == "scanline") order = ORDER_SCANLINE;
+    else if (s == "tiles") order = ORDER_TILES;
+    else if (s == "morton") order = ORDER_MORTON;
+    else return false;
+    return true;
+}
+
+const char* order_name(PixelOrder order)
+{
+    switch (order) {
+    case ORDER_SCANLINE: return "scanline";
+    case ORDER_TILES: return "tiles";
+    default: return "morton";
+    }
+}
+
+TileOrder::TileOrder(int nx, int ny, int tile, PixelOrder order)
+    : nx(nx), ny(ny)
+{
+    if (order == ORDER_SCANLINE) {
+        tw = nx;
+        th = 1;
+    }
+    else {
+        tw = th = tile;
+    }
+    tx = (nx + tw - 1) / tw;
+    ty = (ny + th - 1) / th;
+
+    if (order == ORDER_MORTON) {
+        jobs = morton_cells(tx, ty);
+        pixels = morton_cells(tw, th);
+    }
+    else {
+        jobs = row_cells(tx, ty);
+        pixels = row_cells(tw, th);
+    }
+}
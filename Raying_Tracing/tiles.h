@@ -0,0 +1,70 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <string>
+#include <vector>
+
+// order in which the tracer visits the pixels of an image
+enum PixelOrder
+{
+    ORDER_SCANLINE,   // one full image row per job, left to right
+    ORDER_TILES,      // square tiles row by row, each tile row by row
+    ORDER_MORTON      // square tiles in Z-order, each tile in Z-order
+};
+
+// "scanline", "tiles" or "morton"; false for anything else
+bool parse_order(const std::string& s, PixelOrder& order);
+const char* order_name(PixelOrder order);
+
+// bit k of x and of y interleaved into bits 2k and 2k + 1
+inline unsigned morton2(unsigned x, unsigned y)
+{
+    unsigned code = 0;
+    for (int k = 0; k < 16; k++)
+        code |= ((x >> k) & 1u) << (2 * k) | ((y >> k) & 1u) << (2 * k + 1);
+    return code;
+}
+
+// An nx x ny image cut into jobs of tw x th pixels, with the order the
+// jobs are handed out in and the order of the pixels within a job.
+//
+// In Z-order consecutive pixels (and consecutive tiles) stay close in
+// both directions, so consecutive primary rays go through the same BVH
+// nodes and leaves while they are still in cache. Images and tiles that
+// are not a power of two in size are ordered as the enclosing power of
+// two square with the missing cells skipped.
+struct TileOrder
+{
+    int nx, ny;
+    int tw, th;                // job size in pixels
+    int tx, ty;                // jobs per row and per column
+    std::vector<int> jobs;     // tile index (row * tx + column) of every job, in order
+    std::vector<int> pixels;   // dy * tw + dx of the pixels of a full tile, in order
+
+    TileOrder(int nx, int ny, int tile, PixelOrder order);
+
+    int count() const { return (int) jobs.size(); }
+
+    // pixels [x0, x1) x [y0, y1) of job k
+    void bounds(int k, int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = jobs[k] % tx * tw;
+        y0 = jobs[k] / tx * th;
+        x1 = x0 + tw < nx ? x0 + tw : nx;
+        y1 = y0 + th < ny ? y0 + th : ny;
+    }
+
+    // calls f(i, j) for every pixel of job k, in order
+    template <typename F>
+    void for_each_pixel(int k, F f) const
+    {
+        int x0, y0, x1, y1;
+        bounds(k, x0, y0, x1, y1);
+        for (int p : pixels) {
+            int i = x0 + p % tw, j = y0 + p / tw;
+            if (i < x1 && j < y1) f(i, j);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "parallel.h"
+
+World<double> world_double;
+World<float> world_float;
+
+bool use_bvh = true;
+bool shadows = false;
+
+#ifdef TRACER_COST
+thread_local PixelCost pixel_cost;
+#endif
+
+namespace {
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// closest primitive of bvh, or of all of soa with --no-bvh
+template <typename T, typename SoA>
+bool hit_prims(const BVHT<T, SoA>& bvh, const SoA& soa, const RayT<T>& ray, T& t, int& idx,
+               TraversalStats* stats)
+{
+    if (use_bvh)
+        return stats ? bvh.intersect(ray, t, idx, *stats) : bvh.intersect(ray, t, idx);
+
+    // brute force, kept for comparison (--no-bvh)
+    if (stats) {
+        stats->leaves += soa.size() / SoA::BLOCK;
+        stats->tests(soa) += soa.size();
+    }
+    T valt = std::numeric_limits<T>::infinity();
+    bool hit = false;
+    for (size_t k = 0; k < soa.size(); k += SoA::BLOCK) {
+        int lane = SoA::intersect(soa, k, ray, valt, valt);
+        if (lane >= 0) {
+            hit = true;
+            t = valt;
+            idx = (int) k + lane;
+        }
+    }
+
+    return hit;
+}
+
+// true if something of bvh (soa with --no-bvh) blocks the ray before tmax
+template <typename T, typename SoA>
+bool occluded_prims(const BVHT<T, SoA>& bvh, const SoA& soa, const RayT<T>& ray, T tmax)
+{
+    if (use_bvh)
+        return bvh.occluded(ray, tmax);
+
+    T t;
+    for (size_t k = 0; k < soa.size(); k += SoA::BLOCK) {
+        if (SoA::intersect(soa, k, ray, tmax, t) >= 0) return true;
+    }
+    return false;
+}
+
+// Calculating the intensity using Lambert's law
+template <typename T>
+T lambert(int surface_idx, const RayT<T>& ray, T t)
+{
+    typedef glm::tvec3<T> vec;
+    const World<T>& w = world<T>();
+
+    vec Pn = w.eye + (t * ray.d);
+    vec n_hat = surface_normal(surface_idx, Pn, ray.d);
+    vec to_light = w.light - Pn;
+    T dist = glm::length(to_light);
+    vec l_hat = to_light / dist;
+    T lambC = glm::dot(n_hat, l_hat);
+    if (lambC <= 0) return 0;
+
+    // the hit point is in shadow if anything lies between it and the
+    // light; the eps in the sphere test keeps it from shadowing itself
+    if (shadows && occluded(RayT<T>(Pn, l_hat), dist)) return 0;
+    return lambC;
+}
+
+}
+
+template <typename T>
+void build_world(const std::vector<Sphere>& spheres, const Mesh& mesh, const vec3& eye, const vec3& light)
+{
+    World<T>& w = world<T>();
+    w.spheres.clear();
+    for (auto& s : spheres)
+        w.spheres.push_back(SphereT<T>(s));
+    w.eye = glm::tvec3<T>(eye);
+    w.light = glm::tvec3<T>(light);
+
+    w.mesh = MeshT<T>(mesh);
+
+    if (!use_bvh) {
+        w.all_spheres.clear();
+        for (auto& s : w.spheres)
+            w.all_spheres.push(s);
+        w.all_spheres.pad();
+        w.all_triangles.clear();
+        for (size_t k = 0; k < w.mesh.triangles(); k++)
+            w.all_triangles.push(w.mesh, k);
+        w.all_triangles.pad();
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    w.bvh.build(w.spheres);
+    w.bvh_ms = ms_since(start);
+
+    w.mesh_bvh = MeshBVHT<T>();
+    if (w.mesh.triangles() == 0) return;
+    start = std::chrono::steady_clock::now();
+    w.mesh_bvh.build(w.mesh);
+    w.mesh_bvh_ms = ms_since(start);
+}
+
+template <typename T>
+bool hit(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats* stats)
+{
+    const World<T>& w = world<T>();
+#ifdef TRACER_COST
+    if (!stats) stats = &pixel_cost.trav;
+#endif
+    if (stats) stats->rays++;
+    bool found = hit_prims(w.bvh, w.all_spheres, ray, t, surface_idx, stats);
+    if (w.mesh.triangles() == 0) return found;
+
+    // a sphere wins a tie
+    T tt;
+    int tri;
+    if (hit_prims(w.mesh_bvh, w.all_triangles, ray, tt, tri, stats) && (!found || tt < t)) {
+        t = tt;
+        surface_idx = (int) w.spheres.size() + tri;
+        found = true;
+    }
+    return found;
+}
+
+template <typename T>
+bool occluded(const RayT<T>& ray, T tmax)
+{
+    const World<T>& w = world<T>();
+    return occluded_prims(w.bvh, w.all_spheres, ray, tmax) ||
+           (w.mesh.triangles() > 0 && occluded_prims(w.mesh_bvh, w.all_triangles, ray, tmax));
+}
+
+template <typename T>
+glm::tvec3<T> surface_normal(int idx, const glm::tvec3<T>& p, const glm::tvec3<T>& d)
+{
+    const World<T>& w = world<T>();
+    if (idx < (int) w.spheres.size()) return w.spheres[idx].normal(p);
+    return w.mesh.normal(idx - w.spheres.size(), d);
+}
+
+template <typename T>
+glm::tvec3<T> surface_color(int idx)
+{
+    const World<T>& w = world<T>();
+    if (idx < (int) w.spheres.size()) return w.spheres[idx].c;
+    return w.mesh.color(idx - w.spheres.size());
+}
+
+// Calculating the color of the ray
+template <typename T>
+glm::tvec3<T> ray_color(const RayT<T>& ray)
+{
+    T t;
+    int surface_idx;
+
+    bool is_hit = hit(ray, t, surface_idx);
+    if (is_hit) {
+#ifdef TRACER_COST
+        auto start = std::chrono::steady_clock::now();
+        T l = lambert(surface_idx, ray, t);
+        pixel_cost.shade_ns +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return surface_color<T>(surface_idx) * l;
+#else
+        return surface_color<T>(surface_idx) * lambert(surface_idx, ray, t);
+#endif
+    }
+    else {
+        return glm::tvec3<T>(0, 0, 0);
+    }
+}
+
+unsigned char to_byte(double c)
+{
+    int v = (int) (c * 255);
+    return (unsigned char) (v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+template <typename T>
+void trace_primary(const Camera& cam, const TileOrder& tiles, int k, GBufferT<T>& g, TraversalStats* stats)
+{
+    const World<T>& w = world<T>();
+    tiles.for_each_pixel(k, [&](int i, int j) {
+        RayT<T> r(cam.primary(i, j));
+        T t;
+        int idx;
+        if (!hit(r, t, idx, stats)) return;
+        glm::tvec3<T> Pn = w.eye + (t * r.d);
+        g.set((size_t) j * cam.nx + i, idx, t, Pn, surface_normal(idx, Pn, r.d), surface_color<T>(idx));
+    });
+}
+
+template <typename T>
+void shade_gbuffer(const GBufferT<T>& g, unsigned char* rgb, int nthreads)
+{
+    typedef glm::tvec3<T> vec;
+    const World<T>& w = world<T>();
+    const int ROWS = 16;     // rows per job
+    std::vector<T> lamb(g.size());
+
+    parallel_for((g.ny + ROWS - 1) / ROWS, nthreads, [&](int c, int) {
+        size_t begin = (size_t) c * ROWS * g.nx;
+        size_t end = std::min(begin + (size_t) ROWS * g.nx, g.size());
+        lambert_pass(g, w.light, begin, end, &lamb[0]);
+
+        for (size_t k = begin; k < end; k++) {
+            T l = lamb[k];
+            if (shadows && l > 0) {
+                vec Pn = g.position(k);
+                vec to_light = w.light - Pn;
+                T dist = glm::length(to_light);
+                if (occluded(RayT<T>(Pn, to_light / dist), dist)) l = 0;
+            }
+            for (int a = 0; a < 3; a++)
+                rgb[k * 3 + a] = to_byte(g.albedo[a][k] * l);
+        }
+    });
+}
+
+#define TRACER_INSTANTIATE(T)                                                                               \
+    template void build_world<T>(const std::vector<Sphere>&, const Mesh&, const vec3&, const vec3&);       \
+    template bool hit(const RayT<T>&, T&, int&, TraversalStats*);                                          \
+    template bool occluded(const RayT<T>&, T);                                                             \
+    template glm::tvec3<T> surface_normal(int, const glm::tvec3<T>&, const glm::tvec3<T>&);                 \
+    template glm::tvec3<T> surface_color<T>(int);                                                          \
+    template glm::tvec3<T> ray_color(const RayT<T>&);                                                      \
+    template void trace_primary(const Camera&, const TileOrder&, int, GBufferT<T>&, TraversalStats*);      \
+    template void shade_gbuffer(const GBufferT<T>&, unsigned char*, int);
+
+TRACER_INSTANTIATE(double)
+TRACER_INSTANTIATE(float)
@@ -0,0 +1,97 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "bvh.h"
+#include "camera.h"
+#include "gbuffer.h"
+#include "tiles.h"
+#ifdef TRACER_COST
+#include "cost.h"
+#endif
+
+// The Lambert tracer: the scene in scalar type T with its acceleration
+// structures, and the code that traces and shades rays in it. template
+// renders its images with these functions and bench times the same ones,
+// so what is benchmarked is what ships.
+
+// The scene converted to scalar type T, along with its acceleration
+// structures; set up by build_world<T>() once the scene is final. All
+// tracing goes through world<T>().
+//
+// Surfaces are numbered spheres first, then the triangles of the mesh:
+// surface spheres.size() + k is triangle k.
+template <typename T>
+struct World
+{
+    typedef glm::tvec3<T> vec;
+
+    std::vector<SphereT<T>> spheres;
+    MeshT<T> mesh;
+    vec eye, light;
+    BVHT<T> bvh;
+    MeshBVHT<T> mesh_bvh;
+    SphereSoAT<T> all_spheres;      // every sphere in scene order, for --no-bvh
+    TriangleSoAT<T> all_triangles;  // the same for the triangles
+    double bvh_ms = 0, mesh_bvh_ms = 0;   // build times
+};
+
+extern World<double> world_double;
+extern World<float> world_float;
+
+template <typename T> World<T>& world();
+template <> inline World<double>& world() { return world_double; }
+template <> inline World<float>& world() { return world_float; }
+
+extern bool use_bvh;      // false: test every primitive for every ray
+extern bool shadows;      // cast shadow rays towards the light
+
+#ifdef TRACER_COST
+// cost of the pixel this thread is tracing
+extern thread_local PixelCost pixel_cost;
+#endif
+
+// converts the scene to T and builds what hit() needs (the BVHs, or the
+// flat primitive lists without use_bvh)
+template <typename T>
+void build_world(const std::vector<Sphere>& spheres, const Mesh& mesh, const vec3& eye, const vec3& light);
+
+// closest surface hit by ray with t > eps; with stats, the BVH work is
+// counted into it
+template <typename T>
+bool hit(const RayT<T>& ray, T& t, int& surface_idx, TraversalStats* stats = nullptr);
+
+// true if something blocks the ray before tmax (any hit, not the closest)
+template <typename T>
+bool occluded(const RayT<T>& ray, T tmax);
+
+// unit normal of surface idx at p, on the side of a ray with direction d
+template <typename T>
+glm::tvec3<T> surface_normal(int idx, const glm::tvec3<T>& p, const glm::tvec3<T>& d);
+
+template <typename T>
+glm::tvec3<T> surface_color(int idx);
+
+// color of the ray: the surface color times Lambert's cosine term, 0 in
+// shadow with shadows, black for a miss
+template <typename T>
+glm::tvec3<T> ray_color(const RayT<T>& ray);
+
+// [0, 1] channel to 8-bit
+unsigned char to_byte(double c);
+
+// the primary hits of the pixels of job k of tiles into g, which has the
+// size of the image; with stats, the BVH work is counted into it
+template <typename T>
+void trace_primary(const Camera& cam, const TileOrder& tiles, int k, GBufferT<T>& g,
+                   TraversalStats* stats = nullptr);
+
+// shades g with the current light on nthreads threads into rgb (3 bytes
+// per pixel), giving the same image as ray_color() of the primary rays;
+// no primary rays are traced, only shadow rays
+template <typename T>
+void shade_gbuffer(const GBufferT<T>& g, unsigned char* rgb, int nthreads);
+
+#endif
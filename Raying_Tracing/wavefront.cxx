@@ -0,0 +1,223 @@
+#include "wavefront.h"
+
+#include <algorithm>
+#include "parallel.h"
+#include "sampling.h"
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// paths per parallel job in the extend and shade stages
+const int BATCH = 2048;
+
+struct Path
+{
+    vec3 o, d;           // current ray
+    vec3 throughput;     // product of the surface colors so far
+    vec3 L;              // radiance gathered so far
+    Rng rng;
+    int slot;            // index of this path in the chunk's result array
+    int depth;           // bounces so far
+    int surface;         // sphere hit by the current ray, -1 for a miss
+    double t;            // distance to that hit
+
+    Path() : rng(0) {}
+};
+
+// runs f(k) for k in [begin, end) in parallel batches
+template <typename F>
+void for_batches(ThreadPool& pool, int begin, int end, F f)
+{
+    int n = end - begin;
+    pool.run((n + BATCH - 1) / BATCH, [&](int b, int) {
+        int e = std::min(begin + (b + 1) * BATCH, end);
+        for (int k = begin + b * BATCH; k < e; k++)
+            f(k);
+    });
+}
+
+// unit vector around n with a cosine-weighted distribution
+vec3 cosine_sample(const vec3& n, Rng& rng)
+{
+    double r1 = 2 * PI * rng.uniform(), r2 = rng.uniform(), r2s = std::sqrt(r2);
+    vec3 u = glm::normalize(glm::cross(std::fabs(n[0]) > .1 ? vec3(0, 1, 0) : vec3(1, 0, 0), n));
+    vec3 v = glm::cross(n, u);
+    return glm::normalize(u * (std::cos(r1) * r2s) + v * (std::sin(r1) * r2s) + n * std::sqrt(1 - r2));
+}
+
+// Adds the emission at the hit of p and plays Russian roulette on the
+// surface color f. Returns false if the path ends here, otherwise leaves
+// the hit point in x, the normal in n, the normal facing the ray in nl.
+bool begin_shade(Path& p, const Sphere& s, const PathTraceSettings& st,
+                 vec3& x, vec3& n, vec3& nl, vec3& f)
+{
+    x = p.o + p.d * p.t;
+    n = s.normal(x);
+    nl = glm::dot(n, p.d) < 0 ? n : -n;
+    f = s.c;
+    p.L += p.throughput * s.e;
+
+    if (p.depth >= st.max_depth) return false;
+    if (++p.depth > st.rr_depth) {
+        double q = std::max(f[0], std::max(f[1], f[2]));
+        if (p.rng.uniform() >= q) return false;
+        f = f * (1 / q);
+    }
+    p.throughput *= f;
+    return true;
+}
+
+bool shade_diff(Path& p, const Sphere& s, const PathTraceSettings& st)
+{
+    vec3 x, n, nl, f;
+    if (!begin_shade(p, s, st, x, n, nl, f)) return false;
+    p.o = x;
+    p.d = cosine_sample(nl, p.rng);
+    return true;
+}
+
+bool shade_spec(Path& p, const Sphere& s, const PathTraceSettings& st)
+{
+    vec3 x, n, nl, f;
+    if (!begin_shade(p, s, st, x, n, nl, f)) return false;
+    p.o = x;
+    p.d = p.d - n * (2 * glm::dot(n, p.d));
+    return true;
+}
+
+// glass with index 1.5, Fresnel term after Schlick; picks either the
+// reflected or the refracted ray and reweights the path accordingly
+bool shade_refr(Path& p, const Sphere& s, const PathTraceSettings& st)
+{
+    vec3 x, n, nl, f;
+    if (!begin_shade(p, s, st, x, n, nl, f)) return false;
+
+    vec3 refl = p.d - n * (2 * glm::dot(n, p.d));
+    bool into = glm::dot(n, nl) > 0;
+    double nc = 1, nt = 1.5, nnt = into ? nc / nt : nt / nc;
+    double ddn = glm::dot(p.d, nl);
+    double cos2t = 1 - nnt * nnt * (1 - ddn * ddn);
+    p.o = x;
+    if (cos2t < 0) {
+        // total internal reflection
+        p.d = refl;
+        return true;
+    }
+
+    vec3 tdir = glm::normalize(p.d * nnt - n * ((into ? 1 : -1) * (ddn * nnt + std::sqrt(cos2t))));
+    double a = nt - nc, b = nt + nc, R0 = a * a / (b * b);
+    double c = 1 - (into ? -ddn : glm::dot(tdir, n));
+    double Re = R0 + (1 - R0) * c * c * c * c * c, Tr = 1 - Re;
+    double P = .25 + .5 * Re;
+    if (p.rng.uniform() < P) {
+        p.d = refl;
+        p.throughput *= Re / P;
+    }
+    else {
+        p.d = tdir;
+        p.throughput *= Tr / (1 - P);
+    }
+    return true;
+}
+
+}
+
+PathTraceStats path_trace(const Camera& cam, const std::vector<Sphere>& spheres, const BVH& bvh,
+                          const PathTraceSettings& st, int nthreads,
+                          std::vector<vec3>& radiance, int y0, int rows)
+{
+    PathTraceStats stats;
+    if (rows < 0) rows = cam.ny - y0;
+    int npixels = cam.nx * rows;
+    radiance.assign(npixels, vec3());
+
+    // a chunk is a run of whole pixels, so that every pixel is reduced once
+    int chunk_pixels = std::max(1, st.wavefront / st.spp);
+    int max_paths = chunk_pixels * st.spp;
+
+    std::vector<Path> queue(max_paths), sorted(max_paths);
+    std::vector<vec3> result(max_paths);
+    std::vector<unsigned char> alive(max_paths);
+    // every stage of every bounce runs on the same threads
+    ThreadPool pool(nthreads);
+
+    for (int first = 0; first < npixels; first += chunk_pixels) {
+        int pixels = std::min(chunk_pixels, npixels - first);
+        int n = pixels * st.spp;
+
+        // generate: jittered camera rays, seeded by pixel and sample
+        for_batches(pool, 0, n, [&](int k) {
+            int pixel = first + k / st.spp, s = k % st.spp;
+            int i = pixel % cam.nx, j = y0 + pixel / cam.nx;
+            Path& p = queue[k];
+            p.rng = Rng(i, j, s);
+            double x = i - 0.5 + p.rng.uniform();
+            double y = j - 0.5 + p.rng.uniform();
+            Ray r = cam.primary(x, y);
+            p.o = r.o;
+            p.d = r.d;
+            p.throughput = vec3(1, 1, 1);
+            p.L = vec3();
+            p.slot = k;
+            p.depth = 0;
+        });
+        stats.paths += n;
+
+        while (n > 0) {
+            // extend
+            for_batches(pool, 0, n, [&](int k) {
+                Path& p = queue[k];
+                if (!bvh.intersect(Ray(p.o, p.d), p.t, p.surface))
+                    p.surface = -1;
+            });
+            stats.segments += n;
+
+            // sort by material (counting sort, stable): misses first, they
+            // are done, then one contiguous run per Refl_t
+            int count[REFR + 2] = {0};
+            for (int k = 0; k < n; k++) {
+                int key = queue[k].surface < 0 ? 0 : spheres[queue[k].surface].refl + 1;
+                count[key]++;
+            }
+            int start[REFR + 3] = {0};
+            for (int m = 0; m < REFR + 2; m++)
+                start[m + 1] = start[m] + count[m];
+            int at[REFR + 2];
+            std::copy(start, start + REFR + 2, at);
+            for (int k = 0; k < n; k++) {
+                int key = queue[k].surface < 0 ? 0 : spheres[queue[k].surface].refl + 1;
+                sorted[at[key]++] = queue[k];
+            }
+
+            // shade, one loop per material
+            std::fill(alive.begin() + start[0], alive.begin() + start[1], 0);
+            for_batches(pool, start[DIFF + 1], start[DIFF + 2], [&](int k) {
+                alive[k] = shade_diff(sorted[k], spheres[sorted[k].surface], st);
+            });
+            for_batches(pool, start[SPEC + 1], start[SPEC + 2], [&](int k) {
+                alive[k] = shade_spec(sorted[k], spheres[sorted[k].surface], st);
+            });
+            for_batches(pool, start[REFR + 1], start[REFR + 2], [&](int k) {
+                alive[k] = shade_refr(sorted[k], spheres[sorted[k].surface], st);
+            });
+
+            // compact the survivors into the next queue
+            int live = 0;
+            for (int k = 0; k < n; k++) {
+                if (alive[k]) queue[live++] = sorted[k];
+                else result[sorted[k].slot] = sorted[k].L;
+            }
+            n = live;
+        }
+
+        // average the samples of every pixel, always in sample order
+        for_batches(pool, 0, pixels, [&](int k) {
+            vec3 sum;
+            for (int s = 0; s < st.spp; s++)
+                sum += result[k * st.spp + s];
+            radiance[first + k] = sum / (double) st.spp;
+        });
+    }
+    return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <vector>
+#include "bvh.h"
+#include "camera.h"
+#include "scene.h"
+
+// Path tracer over DIFF, SPEC and REFR spheres, organised as a wavefront:
+//
+//   generate  camera rays for a chunk of pixels, spp paths per pixel
+//   extend    closest hit for every live path, as one batch
+//   shade     paths sorted by the material they hit, then one tight loop
+//             per material that adds emission, picks the next direction
+//             and plays Russian roulette
+//
+// extend and shade repeat until every path of the chunk is terminated.
+// There is no recursion and no per-path dispatch: each stage is a loop
+// over a queue, and each material loop only sees paths of its material.
+struct PathTraceSettings
+{
+    int spp = 16;                 // paths per pixel
+    int max_depth = 32;           // at most this many bounces, whatever the roulette says
+    int rr_depth = 4;             // Russian roulette starts after this many bounces
+    int wavefront = 1 << 18;      // paths in flight per chunk
+};
+
+struct PathTraceStats
+{
+    long long paths = 0;          // camera paths traced
+    long long segments = 0;       // rays cast in extend stages
+};
+
+// Renders rows y0 to y0 + rows - 1 of the image (all of it if rows < 0)
+// into radiance (nx * rows linear RGB values, rows in tracing order) on
+// nthreads threads. The result does not depend on the thread count, the
+// wavefront size or how the image is split into row ranges.
+PathTraceStats path_trace(const Camera& cam, const std::vector<Sphere>& spheres, const BVH& bvh,
+                          const PathTraceSettings& settings, int nthreads,
+                          std::vector<vec3>& radiance, int y0 = 0, int rows = -1);
+
+#endif